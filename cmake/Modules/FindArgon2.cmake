@@ -0,0 +1,40 @@
+########################################
+#
+# Find the Argon2 reference library and includes
+# This module sets:
+#  ARGON2_FOUND: True if Argon2 was found
+#  ARGON2_LIBRARY:  The Argon2 library
+#  ARGON2_LIBRARIES:  The Argon2 library and dependencies
+#  ARGON2_INCLUDE_DIR:  The Argon2 include dir
+#
+# The caller can hint at locations using the following variables:
+#
+# ARGON2_HOME (passed as -D to cmake)
+# CCNX_DEPENDENCIES (in environment)
+# ARGON2_HOME (in environment)
+#
+
+set(ARGON2_SEARCH_PATH_LIST
+  ${ARGON2_HOME}
+  $ENV{CCNX_DEPENDENCIES}
+  $ENV{ARGON2_HOME}
+  /usr/local
+  /opt
+  /usr
+  )
+
+find_path(ARGON2_INCLUDE_DIR argon2.h
+  HINTS ${ARGON2_SEARCH_PATH_LIST}
+  PATH_SUFFIXES include
+  DOC "Find the Argon2 includes" )
+
+find_library(ARGON2_LIBRARY NAMES argon2
+  HINTS ${ARGON2_SEARCH_PATH_LIST}
+  PATH_SUFFIXES lib
+  DOC "Find the Argon2 libraries" )
+
+set(ARGON2_LIBRARIES ${ARGON2_LIBRARY})
+set(ARGON2_INCLUDE_DIRS ${ARGON2_INCLUDE_DIR})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Argon2  DEFAULT_MSG ARGON2_LIBRARY ARGON2_INCLUDE_DIR)
@@ -3,7 +3,10 @@
 PROGRAM=$1
 OUTFILE=$2
 LENGTHS=( 1500 3000 4500 6000 7500 9000 )
-ALGS=( "SHA256 0 0" "ARGON2 4 33554432" "ARGON2 4 2097152" "ARGON2 4 134217728")
+ALGS=( "SHA256 0 0" "ARGON2 4 33554432" "ARGON2 4 2097152" "ARGON2 4 134217728" "BALLOON 33554432 4 3 1" "BALLOON 2097152 4 3 1" "BALLOON 134217728 4 3 1")
+
+# Record which build configuration produced the numbers
+echo "# `${PROGRAM} 2>&1 | grep '^build:'`" >> ${OUTFILE}
 
 for alg in "${ALGS[@]}"
 do
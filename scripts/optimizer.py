@@ -60,7 +60,7 @@ class Argon2Params(object):
 
 
 class ScryptParams(object):
-    def __init__(self, N = 1, r = 1, p = 1):
+    def __init__(self, N = 2, r = 1, p = 1):
         self.N = N
         self.r = r
         self.p = p
@@ -71,13 +71,14 @@ class ScryptParams(object):
             process = subprocess.Popen([prog, "scrypt", str(self.N), str(self.r), str(self.p)], stdout=subprocess.PIPE)
             pout, err = process.communicate()
             total += (float(pout) / 1000.0)
-        return total / N
+        return total / float(N)
 
     def neighbors(self):
         params = []
-        if self.N >> 2 > 1:
-            params.append(ScryptParams(self.N >> 2, self.r, self.p))
-        params.append(ScryptParams(self.N << 2, self.r, self.p))
+        # N must stay a power of two above 1
+        if self.N >> 1 > 1:
+            params.append(ScryptParams(self.N >> 1, self.r, self.p))
+        params.append(ScryptParams(self.N << 1, self.r, self.p))
 
         if self.r > 1:
             params.append(ScryptParams(self.N, self.r - 1, self.p))
@@ -91,7 +92,7 @@ class ScryptParams(object):
 
     def successors(self):
         params = []
-        params.append(ScryptParams(self.N + 1, self.r, self.p))
+        params.append(ScryptParams(self.N << 1, self.r, self.p))
         params.append(ScryptParams(self.N, self.r + 1, self.p))
         return params
 
@@ -191,8 +192,6 @@ def find_min_params(results):
 
 
 prog = sys.argv[1]
-#scrypt = ScryptParams(1, 1, 1)
-#print scrypt.process(prog)
 
 P_list = [2, 4, 8, 16, 32, 64, 128]
 targets = map(lambda P : int((float(1500) / (P * 1000000)) * 1000000), P_list)
@@ -201,7 +200,7 @@ for i, P in enumerate(targets):
     results = optimize_dfs(prog, initialParams, P)
     print "argon2", P_list[i], find_min_params(results)
 
-    #initialParams = ScryptParams(1, 1, 1)
-    #results = optimize_dfs(prog, initialParams, P)
-    #print "scrypt", P_list[i], find_min_params(results)
+    initialParams = ScryptParams(2, 1, 1)
+    results = optimize_dfs(prog, initialParams, P)
+    print "scrypt", P_list[i], find_min_params(results)
 
@@ -20,6 +20,8 @@ algTimes = {}
 
 with open(dataFileName, "r") as f:
     for line in f:
+        if line.startswith("#"):
+            continue
         data = line.strip().split(",")
         alg = data[0]
         length = int(data[1])
@@ -33,6 +33,8 @@ factor = 1000
 
 with open(dataFileName, "r") as f:
     for line in f:
+        if line.startswith("#"):
+            continue
         data = line.strip().split(",")
         N = int(data[0])
         lengths.append(N)
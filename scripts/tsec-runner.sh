@@ -9,6 +9,11 @@ OUTFILE_Argon2=${URI_FILE}_Argon2.out
 touch ${OUTFILE_SHA256}
 touch ${OUTFILE_Argon2}
 
+# Record which build configuration produced the numbers
+BUILD=`${PROGRAM} 2>&1 | grep '^build:'`
+echo "# ${BUILD}" >> ${OUTFILE_SHA256}
+echo "# ${BUILD}" >> ${OUTFILE_Argon2}
+
 for i in `seq 1 ${PREFIX_LENGTH}`;
 do
     echo ${PROGRAM} ${URI_FILE} ${i}
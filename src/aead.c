@@ -0,0 +1,97 @@
+#include <sodium.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// AEAD backends for content encryption, selected at runtime in the same way
+// hashers are plugged in through PARCCryptoHasherInterface. Every backend uses
+// a 32-byte key and libsodium's detached encrypt/decrypt calling convention.
+
+#define AEAD_KEY_LENGTH 32
+#define AEAD_MAX_NONCE_LENGTH 24
+
+typedef struct {
+    const char *name;
+    size_t nonceLength;
+    size_t tagLength;
+    int (*aead_available)(void);
+    int (*aead_encrypt)(unsigned char *c, unsigned char *mac, unsigned long long *maclen_p,
+                        const unsigned char *m, unsigned long long mlen,
+                        const unsigned char *ad, unsigned long long adlen,
+                        const unsigned char *nsec, const unsigned char *npub, const unsigned char *k);
+    int (*aead_decrypt)(unsigned char *m, unsigned char *nsec,
+                        const unsigned char *c, unsigned long long clen, const unsigned char *mac,
+                        const unsigned char *ad, unsigned long long adlen,
+                        const unsigned char *npub, const unsigned char *k);
+} AEADInterface;
+
+static int
+_aead_AlwaysAvailable(void)
+{
+    return 1;
+}
+
+static AEADInterface functor_chacha20poly1305 = {
+    .name = "chacha20poly1305",
+    .nonceLength = crypto_aead_chacha20poly1305_NPUBBYTES,
+    .tagLength = crypto_aead_chacha20poly1305_ABYTES,
+    .aead_available = _aead_AlwaysAvailable,
+    .aead_encrypt = crypto_aead_chacha20poly1305_encrypt_detached,
+    .aead_decrypt = crypto_aead_chacha20poly1305_decrypt_detached
+};
+
+static AEADInterface functor_chacha20poly1305_ietf = {
+    .name = "chacha20poly1305-ietf",
+    .nonceLength = crypto_aead_chacha20poly1305_ietf_NPUBBYTES,
+    .tagLength = crypto_aead_chacha20poly1305_ietf_ABYTES,
+    .aead_available = _aead_AlwaysAvailable,
+    .aead_encrypt = crypto_aead_chacha20poly1305_ietf_encrypt_detached,
+    .aead_decrypt = crypto_aead_chacha20poly1305_ietf_decrypt_detached
+};
+
+static AEADInterface functor_xchacha20poly1305_ietf = {
+    .name = "xchacha20poly1305-ietf",
+    .nonceLength = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES,
+    .tagLength = crypto_aead_xchacha20poly1305_ietf_ABYTES,
+    .aead_available = _aead_AlwaysAvailable,
+    .aead_encrypt = crypto_aead_xchacha20poly1305_ietf_encrypt_detached,
+    .aead_decrypt = crypto_aead_xchacha20poly1305_ietf_decrypt_detached
+};
+
+// Requires AES-NI and PCLMUL; libsodium reports whether the CPU has them
+static AEADInterface functor_aes256gcm = {
+    .name = "aes256gcm",
+    .nonceLength = crypto_aead_aes256gcm_NPUBBYTES,
+    .tagLength = crypto_aead_aes256gcm_ABYTES,
+    .aead_available = crypto_aead_aes256gcm_is_available,
+    .aead_encrypt = crypto_aead_aes256gcm_encrypt_detached,
+    .aead_decrypt = crypto_aead_aes256gcm_decrypt_detached
+};
+
+/**
+ * Look up a backend by name. "auto" picks AES-256-GCM when the CPU accelerates
+ * it and IETF ChaCha20-Poly1305 otherwise. Returns NULL for unknown names and
+ * for backends the CPU cannot run.
+ */
+const AEADInterface *
+aead_Select(const char *name)
+{
+    AEADInterface *backends[] = {
+        &functor_chacha20poly1305,
+        &functor_chacha20poly1305_ietf,
+        &functor_xchacha20poly1305_ietf,
+        &functor_aes256gcm
+    };
+
+    if (strcmp(name, "auto") == 0) {
+        return functor_aes256gcm.aead_available() ? &functor_aes256gcm : &functor_chacha20poly1305_ietf;
+    }
+
+    size_t i;
+    for (i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(name, backends[i]->name) == 0) {
+            return backends[i]->aead_available() ? backends[i] : NULL;
+        }
+    }
+    return NULL;
+}
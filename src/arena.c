@@ -0,0 +1,136 @@
+#include <parc/algol/parc_Object.h>
+#include <parc/algol/parc_Memory.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Bump allocator for memory that only lives for one packet (or one batch).
+//
+// Allocations are carved from the current block by advancing an offset and are
+// all released together by arena_Reset. When an iteration outgrows the block,
+// the overflow is served from extra blocks and the next reset replaces them with
+// a single block sized for the high-water mark, so in steady state an
+// allocation is a pointer bump and a reset is one store. An arena is not
+// synchronized; give each thread its own.
+
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t capacity;
+    size_t used;
+    uint8_t *data;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;       // block allocations are currently served from
+    size_t used;            // bytes handed out since the last reset, across blocks
+    size_t highWater;
+    uint64_t overflows;
+} Arena;
+
+static ArenaBlock *
+_arenaBlock_Create(size_t capacity, ArenaBlock *next)
+{
+    ArenaBlock *block = parcMemory_Allocate(sizeof(ArenaBlock));
+    block->data = parcMemory_Allocate(capacity + ARENA_ALIGNMENT);
+    block->capacity = capacity + ARENA_ALIGNMENT;
+    block->used = 0;
+    block->next = next;
+    return block;
+}
+
+static void
+_arena_ReleaseBlocks(Arena *arena)
+{
+    while (arena->head != NULL) {
+        ArenaBlock *next = arena->head->next;
+        parcMemory_Deallocate(&arena->head->data);
+        parcMemory_Deallocate(&arena->head);
+        arena->head = next;
+    }
+}
+
+static bool
+_arena_Destructor(Arena **arenaPtr)
+{
+    _arena_ReleaseBlocks(*arenaPtr);
+    return true;
+}
+
+parcObject_Override(Arena, PARCObject,
+                    .destructor = (PARCObjectDestructor *) _arena_Destructor);
+
+parcObject_ImplementAcquire(arena, Arena);
+parcObject_ImplementRelease(arena, Arena);
+
+/**
+ * Create an arena whose first block holds capacity bytes.
+ */
+Arena *
+arena_Create(size_t capacity)
+{
+    Arena *arena = parcObject_CreateInstance(Arena);
+    if (arena != NULL) {
+        arena->head = _arenaBlock_Create(capacity, NULL);
+        arena->used = 0;
+        arena->highWater = 0;
+        arena->overflows = 0;
+    }
+    return arena;
+}
+
+/**
+ * Return length bytes aligned to ARENA_ALIGNMENT, valid until the next arena_Reset.
+ */
+void *
+arena_Allocate(Arena *arena, size_t length)
+{
+    ArenaBlock *block = arena->head;
+    uintptr_t base = (uintptr_t) block->data;
+    size_t offset = ((base + block->used + ARENA_ALIGNMENT - 1) & ~((uintptr_t) ARENA_ALIGNMENT - 1)) - base;
+
+    if (offset + length > block->capacity) {
+        size_t capacity = block->capacity > length ? block->capacity : length;
+        block = _arenaBlock_Create(capacity, block);
+        arena->head = block;
+        arena->overflows++;
+        base = (uintptr_t) block->data;
+        offset = ((base + ARENA_ALIGNMENT - 1) & ~((uintptr_t) ARENA_ALIGNMENT - 1)) - base;
+    }
+
+    block->used = offset + length;
+    arena->used += length;
+    return block->data + offset;
+}
+
+/**
+ * Release everything allocated since the last reset.
+ */
+void
+arena_Reset(Arena *arena)
+{
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+    arena->used = 0;
+
+    if (arena->head->next != NULL) {
+        // Fold the overflow blocks into one block that fits the whole iteration
+        size_t capacity = 0;
+        ArenaBlock *block;
+        for (block = arena->head; block != NULL; block = block->next) {
+            capacity += block->capacity;
+        }
+        _arena_ReleaseBlocks(arena);
+        arena->head = _arenaBlock_Create(capacity, NULL);
+    } else {
+        arena->head->used = 0;
+    }
+}
+
+size_t
+arena_HighWater(const Arena *arena)
+{
+    return arena->highWater > arena->used ? arena->highWater : arena->used;
+}
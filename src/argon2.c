@@ -1,12 +1,16 @@
 #include <sodium/crypto_pwhash.h>
+#include <sodium/randombytes.h>
+
+#include <argon2.h>
 
 #include <parc/algol/parc_Buffer.h>
-#include <parc/security/parc_SecureRandom.h>
 #include <parc/security/parc_CryptoHasher.h>
 
+#include <string.h>
+
 int argon2TCost;
-int argon2MCost;
-int argon2DCost;
+int argon2MCost;   // bytes
+int argon2DCost;   // lanes (degree of parallelism)
 
 void
 argon2_init()
@@ -16,6 +20,12 @@ argon2_init()
     argon2DCost = 1;
 }
 
+#define ARGON2_HASH_LENGTH 32
+
+// Digest and salt are stored inline and outputBuffer is a view of the digest
+// created once, so Init, Update and Finalize never allocate. Update computes the
+// digest in place, so the buffer returned by Finalize is only valid until the
+// next Update; FinalizeInto copies the digest out instead.
 typedef struct {
     int hashLength;
     int saltLength;
@@ -23,9 +33,9 @@ typedef struct {
     uint32_t mCost;
     uint32_t parallelism;
 
+    uint8_t digest[ARGON2_HASH_LENGTH];
+    uint8_t salt[crypto_pwhash_SALTBYTES];
     PARCBuffer *outputBuffer;
-    PARCBuffer *saltBuffer;
-    PARCSecureRandom *rng;
 } Argon2Hasher;
 
 static bool
@@ -35,76 +45,103 @@ _argon2Hasher_Destructor(Argon2Hasher **hasherPtr)
     if (hasher->outputBuffer != NULL) {
         parcBuffer_Release(&hasher->outputBuffer);
     }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
-    }
-    parcSecureRandom_Release(&hasher->rng);
     return true;
 }
 
 parcObject_Override(Argon2Hasher, PARCObject,
     .destructor = (PARCObjectDestructor *) _argon2Hasher_Destructor);
 
-Argon2Hasher *
-argon2Hasher_Create(void *env)
+static Argon2Hasher *
+_argon2Hasher_Create(uint32_t tCost, uint32_t mCost, uint32_t parallelism)
 {
     Argon2Hasher *hasher = parcObject_CreateInstance(Argon2Hasher);
     if (hasher != NULL) {
-        hasher->hashLength = 32;
-        hasher->saltLength = 16;
-        hasher->tCost = argon2TCost;
-        hasher->mCost = argon2MCost;
-        hasher->parallelism = argon2DCost;
-        hasher->rng = parcSecureRandom_Create();
-        hasher->outputBuffer = NULL;
-        hasher->saltBuffer = NULL;
+        hasher->hashLength = ARGON2_HASH_LENGTH;
+        hasher->saltLength = crypto_pwhash_SALTBYTES;
+        hasher->tCost = tCost;
+        hasher->mCost = mCost;
+        hasher->parallelism = parallelism;
+        memset(hasher->digest, 0, sizeof(hasher->digest));
+        memset(hasher->salt, 0, sizeof(hasher->salt));
+        hasher->outputBuffer = parcBuffer_Wrap(hasher->digest, ARGON2_HASH_LENGTH, 0, ARGON2_HASH_LENGTH);
     }
     return hasher;
 }
 
+Argon2Hasher *
+argon2Hasher_Create(void *env)
+{
+    return _argon2Hasher_Create(argon2TCost, argon2MCost, argon2DCost);
+}
+
 Argon2Hasher *
 argon2Hasher_2_8_Create(void *env)
 {
-    Argon2Hasher *hasher = parcObject_CreateInstance(Argon2Hasher);
-    if (hasher != NULL) {
-        hasher->hashLength = 32;
-        hasher->saltLength = 16;
-        hasher->tCost = 2;
-        hasher->mCost = 8;
-        hasher->parallelism = 1;
-        hasher->rng = parcSecureRandom_Create();
-        hasher->outputBuffer = NULL;
-        hasher->saltBuffer = NULL;
-    }
-    return hasher;
+    return _argon2Hasher_Create(2, 8, 1);
 }
 
 int
 argon2Hasher_Init(Argon2Hasher *hasher)
 {
-    if (hasher->outputBuffer != NULL) {
-        parcBuffer_Release(&hasher->outputBuffer);
-    }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
+    // A fresh salt per hash, drawn straight into the hasher, unless it is keyed
+    if (!keyedSalt_Enabled()) {
+        randombytes_buf(hasher->salt, hasher->saltLength);
     }
-
-    hasher->outputBuffer = parcBuffer_Allocate(hasher->hashLength);
-    hasher->saltBuffer = parcBuffer_Allocate(crypto_pwhash_SALTBYTES);
-    parcSecureRandom_NextBytes(hasher->rng, hasher->saltBuffer);
-
     return 0;
 }
 
 int
 argon2Hasher_Update(Argon2Hasher *hasher, const void *buffer, size_t length)
 {
-    char *salt = parcBuffer_Overlay(hasher->saltBuffer, 0);
-    char *hash = parcBuffer_Overlay(hasher->outputBuffer, 0);
-    int result = crypto_pwhash(hash, hasher->hashLength, buffer, length, salt, hasher->tCost, hasher->mCost, hasher->parallelism);
+    if (keyedSalt_Enabled()) {
+        keyedSalt_Derive(buffer, length, hasher->salt, hasher->saltLength);
+    }
+
+    // libsodium only computes single-lane Argon2 and allocates its own memory.
+    // Wider hashes, and every hash once the block pool is on, go through
+    // argon2_ctx; lanes run on as many threads as the shared pool can spare.
+    // Both paths compute Argon2id v1.3, so for one lane they agree.
+    int result;
+    if (hasher->parallelism <= 1 && !blockPool_Enabled()) {
+        result = crypto_pwhash(hasher->digest, hasher->hashLength, buffer, length, hasher->salt,
+                               hasher->tCost, hasher->mCost, crypto_pwhash_ALG_ARGON2ID13);
+    } else {
+        argon2_context context;
+        memset(&context, 0, sizeof(context));
+        context.out = hasher->digest;
+        context.outlen = hasher->hashLength;
+        context.pwd = (uint8_t *) buffer;
+        context.pwdlen = (uint32_t) length;
+        context.salt = hasher->salt;
+        context.saltlen = hasher->saltLength;
+        context.t_cost = hasher->tCost;
+        context.m_cost = hasher->mCost / 1024;
+        context.lanes = hasher->parallelism > 1 ? hasher->parallelism : 1;
+        context.version = ARGON2_VERSION_13;
+        if (blockPool_Enabled()) {
+            context.allocate_cbk = blockPool_Allocate;
+            context.free_cbk = blockPool_Free;
+        }
+
+        context.threads = context.lanes > 1 ? hashPool_Acquire(context.lanes) : 1;
+        result = argon2_ctx(&context, Argon2_id);
+        if (context.lanes > 1) {
+            hashPool_Release(context.threads);
+        }
+    }
     return (result == 0 ? length : -1);
 }
 
+/**
+ * Copy the digest of the last Update into the caller's digest, which must hold
+ * ARGON2_HASH_LENGTH bytes.
+ */
+void
+argon2Hasher_FinalizeInto(Argon2Hasher *hasher, uint8_t *digest)
+{
+    memcpy(digest, hasher->digest, hasher->hashLength);
+}
+
 PARCBuffer *
 argon2Hasher_Finalize(Argon2Hasher *hasher)
 {
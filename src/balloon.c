@@ -1,15 +1,45 @@
 #include <balloon.h>
 
+#include <sodium/randombytes.h>
+
 #include <parc/algol/parc_Buffer.h>
-#include <parc/security/parc_SecureRandom.h>
 #include <parc/security/parc_CryptoHasher.h>
 
+#include <string.h>
+
+int balloonSCost;       // space cost
+int balloonTCost;       // rounds
+int balloonNeighbors;   // pseudorandom blocks mixed into each block per round
+int balloonThreads;     // passed to the library as n_threads; part of the digest
+
+void
+balloon_init()
+{
+    balloonSCost = 1024 * 1024;
+    balloonTCost = 3;
+    balloonNeighbors = 3;
+    balloonThreads = 1;
+}
+
+#define BALLOON_HASH_LENGTH 32
+#define BALLOON_SALT_LENGTH 16
+
+// Digest and salt are stored inline and outputBuffer is a view of the digest
+// created once, so Init, Update and Finalize never allocate. Update computes the
+// digest in place, so the buffer returned by Finalize is only valid until the
+// next Update; FinalizeInto copies the digest out instead.
+//
+// The thread count is handed to the library as n_threads, which combines that
+// many instances into the digest, so unlike Argon2 lanes it changes the result.
+// Every instance uses the single-buffer mix; no parallel mix is selected.
 typedef struct {
     int hashLength;
     int saltLength;
     struct balloon_options options;
+
+    uint8_t digest[BALLOON_HASH_LENGTH];
+    uint8_t salt[BALLOON_SALT_LENGTH];
     PARCBuffer *outputBuffer;
-    PARCBuffer *saltBuffer;
 } balloonHasher;
 
 static bool
@@ -19,10 +49,7 @@ _balloonHasher_Destructor(balloonHasher **hasherPtr)
     if (hasher->outputBuffer != NULL) {
         parcBuffer_Release(&hasher->outputBuffer);
     }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
-    }
-    return true; 
+    return true;
 }
 
 parcObject_Override(balloonHasher, PARCObject,
@@ -31,60 +58,62 @@ parcObject_Override(balloonHasher, PARCObject,
 balloonHasher *
 balloonHasher_Create(void *env)
 {
-    balloonHasher *hasher = parcObject_CreateInstance(Argon2Hasher);
+    balloonHasher *hasher = parcObject_CreateInstance(balloonHasher);
     if (hasher != NULL) {
-        hasher->hashLength = 32;
-        hasher->saltLength = 16;
+        hasher->hashLength = BALLOON_HASH_LENGTH;
+        hasher->saltLength = BALLOON_SALT_LENGTH;
 
         struct comp_options comp_opts = {
             .comp = COMP__BLAKE_2B,
             .comb = COMB__HASH
         };
 
-        hasher->options.m_cost = 0;
-        hasher->options.t_cost = 0;
-        hasher->options.n_neighbors = 0;
-        hasher->options.n_threads = 0;
+        hasher->options.m_cost = balloonSCost;
+        hasher->options.t_cost = balloonTCost;
+        hasher->options.n_neighbors = balloonNeighbors;
+        hasher->options.n_threads = balloonThreads;
         hasher->options.comp_opts = comp_opts;
         hasher->options.mix = MIX__BALLOON_SINGLE_BUFFER;
 
-        hasher->outputBuffer = NULL;
-        hasher->saltBuffer = NULL;
+        memset(hasher->digest, 0, sizeof(hasher->digest));
+        memset(hasher->salt, 0, sizeof(hasher->salt));
+        hasher->outputBuffer = parcBuffer_Wrap(hasher->digest, BALLOON_HASH_LENGTH, 0, BALLOON_HASH_LENGTH);
     }
     return hasher;
 }
 
 int
-balloonHasher_Init(scryptHasher *hasher)
+balloonHasher_Init(balloonHasher *hasher)
 {
-    if (hasher->outputBuffer != NULL) {
-        parcBuffer_Release(&hasher->outputBuffer);
-    }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
+    // A fresh salt per hash, drawn straight into the hasher, unless it is keyed
+    if (!keyedSalt_Enabled()) {
+        randombytes_buf(hasher->salt, hasher->saltLength);
     }
-
-    hasher->outputBuffer = parcBuffer_Allocate(hasher->hashLength);
-    hasher->saltBuffer = parcBuffer_Allocate(hasher->saltLength);
-
     return 0;
 }
 
-// http://stackoverflow.com/questions/11126315/what-are-optimal-balloon-work-factors
 int
 balloonHasher_Update(balloonHasher *hasher, const void *buffer, size_t length)
 {
-    const uint8_t *salt = parcBuffer_Overlay(hasher->saltBuffer, 0);
-    uint8_t *hash = parcBuffer_Overlay(hasher->outputBuffer, 0);
-
-    // XXX: compute the hash
-    int error = BalloonHash(hash, hasher->hashLength, buffer, length, salt, hasher->saltLength, &hasher->options);
+    if (keyedSalt_Enabled()) {
+        keyedSalt_Derive(buffer, length, hasher->salt, hasher->saltLength);
+    }
+    return BalloonHash(hasher->digest, hasher->hashLength, buffer, length, hasher->salt, hasher->saltLength,
+                       &hasher->options);
+}
 
-    return error;
+/**
+ * Copy the digest of the last Update into the caller's digest, which must hold
+ * BALLOON_HASH_LENGTH bytes.
+ */
+void
+balloonHasher_FinalizeInto(balloonHasher *hasher, uint8_t *digest)
+{
+    memcpy(digest, hasher->digest, hasher->hashLength);
 }
 
 PARCBuffer *
-balloonHasher_Finalize(scryptHasher *hasher)
+balloonHasher_Finalize(balloonHasher *hasher)
 {
     return parcBuffer_Acquire(hasher->outputBuffer);
 }
@@ -0,0 +1,301 @@
+#include "pipeline.c"
+#include "hashbench.c"
+#include "results.c"
+
+// The benchmark driver: every benchmark behind one command line, with the
+// shared options and one result schema.
+//
+//     bench pipeline    [options] <uri_file> <n> <alg> [params]
+//     bench throughput  -d seconds | -r names [options] <uri_file> <n> <alg> [params]
+//     bench hash-sweep  [options] <low> <high> <alg> [params]
+//     bench single-hash [options] <alg> [params]
+//
+// Each measurement is one record (see results.c) carrying the host, build and
+// library metadata, the algorithm and its parameters, the benchmark settings
+// and the results. A command always writes the same columns: the parameters of
+// other algorithms and counters that were not requested are null, so runs with
+// different algorithms or -P can be appended to one CSV file.
+
+#define BENCH_SWEEP_TRIALS 100
+#define BENCH_SINGLE_TRIALS 10
+#define BENCH_SINGLE_INPUT_LENGTH 32
+
+static void
+usage()
+{
+    fprintf(stderr, "usage: bench <command> [options] <arguments>\n");
+    fprintf(stderr, "   pipeline    [pipeline options] <uri_file> <n> <alg> [params]\n");
+    fprintf(stderr, "               Latency of each stage of the name pipeline (as tsec)\n");
+    fprintf(stderr, "   throughput  -d seconds | -r names [-l rate] [pipeline options] <uri_file> <n> <alg> [params]\n");
+    fprintf(stderr, "               Sustained rates of the name pipeline (as tsec -d/-r)\n");
+    fprintf(stderr, "   hash-sweep  [hash options] <low> <high> <alg> [params]\n");
+    fprintf(stderr, "               Hash latency for every input length from low to high bytes (as obfuscate)\n");
+    fprintf(stderr, "   single-hash [hash options] <alg> [params]\n");
+    fprintf(stderr, "               Hash latency for a 32-byte input (as single)\n");
+    fprintf(stderr, "   alg [params] = SHA256 | ARGON2 [t m [lanes]] | scrypt [N r p] | BALLOON [s t [d [threads]]],\n");
+    fprintf(stderr, "                  or 0-3 in that order\n");
+    fprintf(stderr, "   Options for every command:\n");
+    fprintf(stderr, "   - -f format = Result format: json (one object per line, default) or csv (with a header)\n");
+    fprintf(stderr, "   - -w file   = Append results to this file instead of writing them to stdout\n");
+    fprintf(stderr, "   - -P        = Count cycles, instructions, LLC, dTLB and branch misses (also TSEC_PERF_COUNTERS=1)\n");
+    fprintf(stderr, "   - -g pool   = Serve Argon2 blocks from a pre-faulted pool: prefault, or huge for huge pages\n");
+    fprintf(stderr, "   - -n secret = Namespace secret for keyed memory-hard salts\n");
+    fprintf(stderr, "   - -p cores  = Cores shared by all multi-lane Argon2 hashes\n");
+    fprintf(stderr, "   Hash options, for hash-sweep and single-hash only:\n");
+    fprintf(stderr, "   - -i trials = Hashes per input length (default 100 for hash-sweep, 10 for single-hash)\n");
+    fprintf(stderr, "   Pipeline options, for pipeline and throughput only, are those of tsec: -a, -b batch,\n");
+    fprintf(stderr, "   -c chunk, -e cipher, -H file, -j threads, -k keys, -l rate, -m, -s object, -t table and\n");
+    fprintf(stderr, "   -o table (builds the table and records nothing); throughput also takes -d and -r\n");
+}
+
+static void
+_bench_RecordHash(HashType hashAlgorithm, const BenchOptions *options)
+{
+    results_String("hash", hashType_Name(hashAlgorithm));
+    if (hashAlgorithm == HashType_Argon2) {
+        results_Unsigned("argon2_t", (uint64_t) argon2TCost);
+        results_Unsigned("argon2_m", (uint64_t) argon2MCost);
+        results_Unsigned("argon2_lanes", (uint64_t) argon2DCost);
+    } else {
+        results_Null("argon2_t");
+        results_Null("argon2_m");
+        results_Null("argon2_lanes");
+    }
+    if (hashAlgorithm == HashType_Scrypt) {
+        results_Unsigned("scrypt_N", (uint64_t) scrypt_N);
+        results_Unsigned("scrypt_r", (uint64_t) scrypt_r);
+        results_Unsigned("scrypt_p", (uint64_t) scrypt_p);
+    } else {
+        results_Null("scrypt_N");
+        results_Null("scrypt_r");
+        results_Null("scrypt_p");
+    }
+    if (hashAlgorithm == HashType_Balloon) {
+        results_Unsigned("balloon_s", (uint64_t) balloonSCost);
+        results_Unsigned("balloon_t", (uint64_t) balloonTCost);
+        results_Unsigned("balloon_d", (uint64_t) balloonNeighbors);
+        results_Unsigned("balloon_threads", (uint64_t) balloonThreads);
+    } else {
+        results_Null("balloon_s");
+        results_Null("balloon_t");
+        results_Null("balloon_d");
+        results_Null("balloon_threads");
+    }
+    results_Unsigned("keyed_salt", keyedSalt_Enabled() ? 1 : 0);
+    results_String("block_pool", options->blockPoolMode != NULL ? options->blockPoolMode : "off");
+    results_Unsigned("hash_cores", (uint64_t) options->hashCores);
+}
+
+static void
+_bench_RecordLatency(const char *stage, const Histogram *latency)
+{
+    results_PrefixedDouble(stage, "mean_ns", histogram_Mean(latency));
+    results_PrefixedDouble(stage, "stddev_ns", histogram_StandardDeviation(latency));
+    results_PrefixedUnsigned(stage, "p50_ns", histogram_Percentile(latency, 50.0));
+    results_PrefixedUnsigned(stage, "p90_ns", histogram_Percentile(latency, 90.0));
+    results_PrefixedUnsigned(stage, "p99_ns", histogram_Percentile(latency, 99.0));
+    results_PrefixedUnsigned(stage, "p99_9_ns", histogram_Percentile(latency, 99.9));
+    results_PrefixedUnsigned(stage, "max_ns", latency->max);
+}
+
+// Totals and per-unit averages of every event, scaled if the PMU multiplexed
+// them; events that were not counted, including all of them without -P, are null
+static void
+_bench_RecordCounts(const char *stage, const PerfSample *counts, const char *unit, uint64_t count)
+{
+    int event;
+    for (event = 0; event < PerfEvent_Count; event++) {
+        char key[RESULTS_KEY_LENGTH];
+        double value = 0.0;
+        bool available = perfCounters_Enabled() && perfSample_Value(counts, (PerfEvent) event, &value);
+        results_PrefixedDouble(stage, perfEventNames[event], available ? value : NAN);
+        snprintf(key, sizeof(key), "%s_per_%s", perfEventNames[event], unit);
+        results_PrefixedDouble(stage, key, available && count > 0 ? value / count : NAN);
+    }
+}
+
+static double
+_bench_PerSecond(uint64_t count, uint64_t nanos)
+{
+    return nanos == 0 ? 0.0 : ((double) count) * 1e9 / nanos;
+}
+
+static bool
+_bench_RecordPipeline(const Pipeline *pipeline)
+{
+    const BenchOptions *options = pipeline->options;
+    const Throughput *throughput = &pipeline->throughput;
+
+    results_Begin(pipeline->sustained ? "throughput" : "pipeline");
+    _bench_RecordHash(pipeline->hashAlgorithm, options);
+    results_String("uri_file", pipeline->uriPath);
+    results_Unsigned("prefix_length", (uint64_t) pipeline->N);
+    results_String("cipher", pipeline->cipherName);
+    results_Unsigned("threads", (uint64_t) options->numThreads);
+    results_Unsigned("arena", options->useArena ? 1 : 0);
+    results_Unsigned("memoize_prefixes", options->memoizePrefixes ? 1 : 0);
+    results_Unsigned("batch", (uint64_t) options->batchSize);
+    results_Unsigned("key_cache", (uint64_t) options->keyCacheSize);
+    results_Unsigned("stream_object", options->streamObjectSize);
+    results_Unsigned("stream_chunk", options->streamChunkSize);
+    results_Unsigned("prebuilt_table", options->tablePath != NULL ? 1 : 0);
+    if (pipeline->sustained) {
+        results_Double("duration_s", options->duration);
+        results_Unsigned("name_quota", options->nameCount);
+        results_Double("offered_names_per_sec", options->offeredLoad);
+    }
+
+    results_Unsigned("names", pipeline->sustained ? throughput->names : pipeline->numNames);
+    results_Unsigned("wall_ns", pipeline->wallTime);
+    results_Double("key_cache_hit_rate", pipeline_KeyCacheHitRate(pipeline));
+    results_Double("prefix_hit_rate", pipeline_PrefixHitRate(pipeline));
+    if (pipeline->sustained) {
+        results_Unsigned("late", throughput->late);
+        results_Double("names_per_sec", _bench_PerSecond(throughput->names, pipeline->wallTime));
+        results_Double("payload_bytes_per_sec", _bench_PerSecond(throughput->payloadBytes, pipeline->wallTime));
+        results_Double("cpu_utilization", pipeline->wallTime == 0 ? 0.0 :
+                       ((double) throughput->cpuTime) / ((double) pipeline->wallTime * options->numThreads));
+        results_Double("names_per_core_sec", _bench_PerSecond(throughput->names, throughput->cpuTime));
+    }
+
+    // Name stages count name bytes and content stages count payload bytes
+    const uint64_t busyTimes[TSecStage_Count] = {
+        throughput->obfuscateTime, throughput->deobfuscateTime, throughput->encryptTime, throughput->decryptTime
+    };
+    int stage;
+    for (stage = 0; stage < TSecStage_Count; stage++) {
+        _bench_RecordLatency(tsecStageNames[stage], &pipeline->latency[stage]);
+        if (pipeline->sustained) {
+            uint64_t bytes = stage < TSecStage_Encrypt ? throughput->nameBytes : throughput->payloadBytes;
+            results_PrefixedUnsigned(tsecStageNames[stage], "busy_ns", busyTimes[stage]);
+            results_PrefixedDouble(tsecStageNames[stage], "names_per_core_sec", _bench_PerSecond(throughput->names, busyTimes[stage]));
+            results_PrefixedDouble(tsecStageNames[stage], "bytes_per_core_sec", _bench_PerSecond(bytes, busyTimes[stage]));
+        }
+        _bench_RecordCounts(tsecStageNames[stage], &pipeline->counts[stage], "name", pipeline->latency[stage].count);
+    }
+    return results_End();
+}
+
+static bool
+_bench_Pipeline(const BenchOptions *options, bool sustained)
+{
+    Pipeline pipeline;
+    if (!pipeline_Setup(&pipeline, options)) {
+        return false;
+    }
+    if (pipeline.sustained != sustained) {
+        fprintf(stderr, sustained ? "throughput needs -d seconds or -r names\n" :
+                "-d and -r belong to the throughput command\n");
+        return false;
+    }
+
+    if (options->buildTablePath != NULL) {
+        return pipeline_BuildTable(&pipeline) == 0;
+    }
+    if (!pipeline_Run(&pipeline)) {
+        return false;
+    }
+    bool recorded = _bench_RecordPipeline(&pipeline);
+    pipeline_Release(&pipeline);
+    return recorded;
+}
+
+// hash-sweep with sweep set, otherwise single-hash
+static bool
+_bench_Hash(const BenchOptions *options, bool sweep)
+{
+    int lengthArguments = sweep ? 2 : 0;
+    if (options->argc < lengthArguments + 1) {
+        return false;
+    }
+    size_t low = sweep ? strtoul(options->argv[0], NULL, 10) : BENCH_SINGLE_INPUT_LENGTH;
+    size_t high = sweep ? strtoul(options->argv[1], NULL, 10) : BENCH_SINGLE_INPUT_LENGTH;
+
+    int hashAlgorithm = benchOptions_ParseHash(options->argc - lengthArguments, options->argv + lengthArguments);
+    if (hashAlgorithm < 0 || !benchOptions_Apply(options)) {
+        return false;
+    }
+    if (options->blockPoolMode != NULL && hashAlgorithm == HashType_Argon2) {
+        blockPool_Reserve(argon2MCost, 1);
+    }
+    int trials = options->trials > 0 ? options->trials : (sweep ? BENCH_SWEEP_TRIALS : BENCH_SINGLE_TRIALS);
+
+    DigestHasher *hasher = digestHasher_Create((HashType) hashAlgorithm);
+    PARCSecureRandom *random = parcSecureRandom_Create();
+    HashBenchResult *result = parcMemory_Allocate(sizeof(HashBenchResult));
+
+    bool recorded = true;
+    size_t length;
+    for (length = low; length <= high && recorded; length++) {
+        hashBench_Run(hasher, random, length, trials, false, result);
+
+        results_Begin(sweep ? "hash-sweep" : "single-hash");
+        _bench_RecordHash((HashType) hashAlgorithm, options);
+        results_Unsigned("input_length", length);
+        results_Unsigned("trials", (uint64_t) trials);
+        _bench_RecordLatency("hash", &result->latency);
+        _bench_RecordCounts("hash", &result->counts, "hash", (uint64_t) trials);
+        recorded = results_End();
+    }
+    perfCounters_ReportMissing();
+
+    parcMemory_Deallocate(&result);
+    parcSecureRandom_Release(&random);
+    digestHasher_Release(&hasher);
+    return recorded;
+}
+
+int
+main(int argc, char **argv)
+{
+    buildInfo_Report();
+    if (argc < 2) {
+        usage();
+        exit(-1);
+    }
+    const char *command = argv[1];
+    bool pipelineCommand = strcmp(command, "pipeline") == 0 || strcmp(command, "throughput") == 0;
+    bool hashCommand = strcmp(command, "hash-sweep") == 0 || strcmp(command, "single-hash") == 0;
+    if (!pipelineCommand && !hashCommand) {
+        fprintf(stderr, "Command %s is unknown\n", command);
+        usage();
+        exit(-1);
+    }
+
+    // Options follow the command, so parsing starts from it as if it were argv[0]
+    BenchOptions options;
+    benchOptions_Init(&options);
+    if (!benchOptions_Parse(&options, argc - 1, argv + 1, pipelineCommand ? BENCH_PIPELINE_OPTIONS : BENCH_HASH_OPTIONS)) {
+        usage();
+        exit(-1);
+    }
+
+    if (sodium_init() < 0) {
+        fprintf(stderr, "Could not initialize libsodium\n");
+        exit(-1);
+    }
+    argon2_init();
+    balloon_init();
+    cycleTimer_Init();
+    fprintf(stderr, "timer: %s at %.0f Hz, %.1f ns overhead subtracted\n", cycleTimer_Source(), cycleTimer_Frequency(),
+            cycleTimer_OverheadNanos());
+
+    if (!results_Open(options.format, options.outputPath)) {
+        usage();
+        exit(-1);
+    }
+
+    bool success;
+    if (pipelineCommand) {
+        success = _bench_Pipeline(&options, strcmp(command, "throughput") == 0);
+    } else {
+        success = _bench_Hash(&options, strcmp(command, "hash-sweep") == 0);
+    }
+    results_Close();
+
+    if (!success) {
+        usage();
+        exit(-1);
+    }
+    return 0;
+}
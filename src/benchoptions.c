@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+// Options shared by every benchmark: the flags of the pipeline benchmark, the
+// result format and the hash algorithm with its cost parameters. tsec, obfuscate,
+// single and the bench driver all parse the algorithm the same way, by name
+// (SHA256, ARGON2, scrypt, BALLOON, any case) or by number (0-3), followed by
+// its parameters:
+//
+//     ARGON2  [t m [lanes]]
+//     scrypt  [N r p]
+//     BALLOON [s t [d [threads]]]
+//
+// Parameters that are left out keep the defaults set by argon2_init and balloon_init.
+
+typedef enum {
+    HashType_SHA256 = 0x00,
+    HashType_Argon2 = 0x01,
+    HashType_Scrypt = 0x02,
+    HashType_Balloon = 0x03,
+} HashType;
+
+static const char *hashTypeNames[] = { "SHA256", "ARGON2", "scrypt", "BALLOON" };
+
+// Each front end passes benchOptions_Parse only the options it acts on, so an
+// option that would be ignored is rejected instead
+#define PIPELINE_OPTIONS "ab:c:d:e:g:H:j:k:l:mn:o:p:Pr:s:t:"
+#define RESULT_OPTIONS "f:w:"
+#define TSEC_OPTIONS PIPELINE_OPTIONS
+#define BENCH_PIPELINE_OPTIONS PIPELINE_OPTIONS RESULT_OPTIONS
+#define BENCH_HASH_OPTIONS "g:i:n:p:P" RESULT_OPTIONS
+
+typedef struct {
+    bool useArena;
+    bool memoizePrefixes;
+    bool countEvents;
+    int hashCores;
+    int batchSize;
+    int numThreads;
+    int keyCacheSize;
+    int trials;                 // hash benchmarks: hashes per input; 0 for the command's default
+    size_t streamObjectSize;
+    size_t streamChunkSize;
+    double duration;
+    uint64_t nameCount;
+    double offeredLoad;
+    char *cipherName;
+    char *namespaceSecret;
+    char *blockPoolMode;
+    char *histogramPath;
+    char *buildTablePath;
+    char *tablePath;
+    char *format;               // result format: json or csv
+    char *outputPath;           // where results go; NULL for stdout
+
+    // Arguments left after the options
+    int argc;
+    char **argv;
+} BenchOptions;
+
+void
+benchOptions_Init(BenchOptions *options)
+{
+    memset(options, 0, sizeof(BenchOptions));
+    options->countEvents = getenv("TSEC_PERF_COUNTERS") != NULL;
+    options->numThreads = 1;
+    options->keyCacheSize = 65536;
+    options->streamChunkSize = 65536;
+    options->format = "json";
+}
+
+/**
+ * Parse the options in argv, which starts with the program or command name,
+ * accepting only those in optstring. Returns false on an option outside
+ * optstring or a missing value.
+ */
+bool
+benchOptions_Parse(BenchOptions *options, int argc, char **argv, const char *optstring)
+{
+    int opt;
+    optind = 1;
+    while ((opt = getopt(argc, argv, optstring)) != -1) {
+        switch (opt) {
+            case 'a':
+                options->useArena = true;
+                break;
+            case 'b':
+                options->batchSize = atoi(optarg);
+                break;
+            case 'c':
+                options->streamChunkSize = strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                options->duration = atof(optarg);
+                break;
+            case 'e':
+                options->cipherName = optarg;
+                break;
+            case 'f':
+                options->format = optarg;
+                break;
+            case 'g':
+                options->blockPoolMode = optarg;
+                break;
+            case 'H':
+                options->histogramPath = optarg;
+                break;
+            case 'i':
+                options->trials = atoi(optarg);
+                break;
+            case 'j':
+                options->numThreads = atoi(optarg);
+                break;
+            case 'k':
+                options->keyCacheSize = atoi(optarg);
+                break;
+            case 'l':
+                options->offeredLoad = atof(optarg);
+                break;
+            case 'm':
+                options->memoizePrefixes = true;
+                break;
+            case 'n':
+                options->namespaceSecret = optarg;
+                break;
+            case 'o':
+                options->buildTablePath = optarg;
+                break;
+            case 'p':
+                options->hashCores = atoi(optarg);
+                break;
+            case 'P':
+                options->countEvents = true;
+                break;
+            case 'r':
+                options->nameCount = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                options->streamObjectSize = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                options->tablePath = optarg;
+                break;
+            case 'w':
+                options->outputPath = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+    options->argc = argc - optind;
+    options->argv = argv + optind;
+    return options->numThreads >= 1 && options->streamChunkSize > 0 && options->trials >= 0;
+}
+
+/**
+ * Turn on what the options ask for that does not depend on the workload:
+ * hardware counters, the hash core budget, the namespace secret and the
+ * block pool. Returns false if the block pool mode is unknown.
+ */
+bool
+benchOptions_Apply(const BenchOptions *options)
+{
+    perfCounters_Configure(options->countEvents);
+    hashPool_Configure(options->hashCores > 0 ? (uint32_t) options->hashCores : 0);
+    if (options->namespaceSecret != NULL) {
+        keyedSalt_Configure((const uint8_t *) options->namespaceSecret, strlen(options->namespaceSecret));
+    }
+    if (options->blockPoolMode != NULL) {
+        if (strcmp(options->blockPoolMode, "prefault") != 0 && strcmp(options->blockPoolMode, "huge") != 0) {
+            fprintf(stderr, "Block pool mode %s is unknown\n", options->blockPoolMode);
+            return false;
+        }
+        blockPool_Configure(strcmp(options->blockPoolMode, "huge") == 0);
+    }
+    return true;
+}
+
+const char *
+hashType_Name(HashType hashAlgorithm)
+{
+    return hashTypeNames[hashAlgorithm];
+}
+
+/**
+ * Select the hash algorithm named by argv[0] and set its cost parameters from
+ * the rest of argv. Returns the algorithm, or -1 after saying why on stderr.
+ */
+int
+benchOptions_ParseHash(int argc, char **argv)
+{
+    if (argc < 1) {
+        fprintf(stderr, "Missing hash algorithm\n");
+        return -1;
+    }
+
+    int hashAlgorithm = -1;
+    int i;
+    for (i = 0; i < (int) (sizeof(hashTypeNames) / sizeof(hashTypeNames[0])); i++) {
+        char number[2] = { (char) ('0' + i), '\0' };
+        if (strcasecmp(argv[0], hashTypeNames[i]) == 0 || strcmp(argv[0], number) == 0) {
+            hashAlgorithm = i;
+        }
+    }
+
+    switch (hashAlgorithm) {
+        case HashType_SHA256:
+            break;
+        case HashType_Argon2:
+            if (argc >= 3) { // override the default parameters if present
+                argon2TCost = atoi(argv[1]);
+                argon2MCost = atoi(argv[2]);
+            }
+            if (argc >= 4) {
+                argon2DCost = atoi(argv[3]);
+            }
+            break;
+        case HashType_Scrypt:
+            if (argc >= 4) { // override the default parameters if present
+                scrypt_N = atoi(argv[1]);
+                scrypt_r = atoi(argv[2]);
+                scrypt_p = atoi(argv[3]);
+            }
+            if (!scrypt_ValidParameters(scrypt_N, scrypt_r, scrypt_p)) {
+                fprintf(stderr, "scrypt needs N a power of two above 1 and r, p of at least 1\n");
+                return -1;
+            }
+            break;
+        case HashType_Balloon:
+            if (argc >= 3) { // override the default parameters if present
+                balloonSCost = atoi(argv[1]);
+                balloonTCost = atoi(argv[2]);
+            }
+            if (argc >= 4) {
+                balloonNeighbors = atoi(argv[3]);
+            }
+            if (argc >= 5) {
+                balloonThreads = atoi(argv[4]);
+            }
+            if (balloonSCost < 1 || balloonTCost < 1 || balloonNeighbors < 1 || balloonThreads < 1) {
+                fprintf(stderr, "Balloon costs, neighbors and threads must all be at least 1\n");
+                return -1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Hash algorithm %s is unknown\n", argv[0]);
+            return -1;
+    }
+    return hashAlgorithm;
+}
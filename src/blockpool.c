@@ -0,0 +1,208 @@
+#include <argon2.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Reusable memory for Argon2 blocks.
+//
+// argon2_ctx asks its allocate_cbk for the whole block matrix at the start of a
+// hash and returns it through free_cbk at the end. Served from the heap, that is
+// a fresh mapping of mCost bytes that is faulted in and zeroed on every hash. The
+// pool instead keeps mapped, pre-faulted regions and hands a free one to each
+// hash, so after warm-up a hash touches memory that is already resident.
+// Regions can be backed by explicit huge pages, falling back to transparent huge
+// pages when none are reserved. The callbacks carry no context, so there is one
+// pool per process; it is shared by all threads.
+
+#define BLOCK_POOL_MAX_REGIONS 256
+#define BLOCK_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct {
+    uint8_t *memory;
+    size_t capacity;
+    bool inUse;
+} BlockPoolRegion;
+
+typedef struct {
+    pthread_mutex_t lock;
+    BlockPoolRegion regions[BLOCK_POOL_MAX_REGIONS];
+    size_t numRegions;
+    bool enabled;
+    bool hugePages;
+
+    uint64_t reused;
+    uint64_t mapped;
+} BlockPool;
+
+static BlockPool blockPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .numRegions = 0,
+    .enabled = false,
+    .hugePages = false,
+    .reused = 0,
+    .mapped = 0
+};
+
+/**
+ * Serve Argon2 block memory from the pool from now on, optionally backed by huge pages.
+ */
+void
+blockPool_Configure(bool hugePages)
+{
+    blockPool.enabled = true;
+    blockPool.hugePages = hugePages;
+}
+
+bool
+blockPool_Enabled(void)
+{
+    return blockPool.enabled;
+}
+
+// Map capacity bytes (rounded up to the page size in use) and fault every page in
+static uint8_t *
+_blockPool_Map(size_t *capacity)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    void *memory = MAP_FAILED;
+
+    if (blockPool.hugePages) {
+        size_t length = (*capacity + BLOCK_POOL_HUGE_PAGE_SIZE - 1) & ~((size_t) BLOCK_POOL_HUGE_PAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+        memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (memory == MAP_FAILED) {
+            // No reserved huge pages: ask for transparent ones on an aligned length
+            memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (memory != MAP_FAILED) {
+                madvise(memory, length, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        *capacity = length;
+    } else {
+        *capacity = (*capacity + pageSize - 1) & ~(pageSize - 1);
+        memory = mmap(NULL, *capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Fault the region in now so no hash pays for it
+    size_t offset;
+    for (offset = 0; offset < *capacity; offset += pageSize) {
+        ((volatile uint8_t *) memory)[offset] = 0;
+    }
+    return memory;
+}
+
+// Add a region of at least bytes; called with the lock held
+static BlockPoolRegion *
+_blockPool_AddRegion(size_t bytes)
+{
+    BlockPoolRegion *region = NULL;
+    if (blockPool.numRegions < BLOCK_POOL_MAX_REGIONS) {
+        region = &blockPool.regions[blockPool.numRegions];
+    } else {
+        // Full: replace the smallest free region, the one least likely to fit a
+        // later request, so larger pre-faulted regions stay available
+        size_t i;
+        for (i = 0; i < blockPool.numRegions; i++) {
+            BlockPoolRegion *candidate = &blockPool.regions[i];
+            if (!candidate->inUse && (region == NULL || candidate->capacity < region->capacity)) {
+                region = candidate;
+            }
+        }
+        if (region == NULL) {
+            return NULL;
+        }
+        if (region->memory != NULL) {
+            munmap(region->memory, region->capacity);
+        }
+        region->memory = NULL;
+        region->capacity = 0;
+    }
+
+    size_t capacity = bytes;
+    uint8_t *memory = _blockPool_Map(&capacity);
+    if (memory == NULL) {
+        return NULL;
+    }
+    if (region == &blockPool.regions[blockPool.numRegions]) {
+        blockPool.numRegions++;
+    }
+    region->memory = memory;
+    region->capacity = capacity;
+    region->inUse = false;
+    blockPool.mapped++;
+    return region;
+}
+
+/**
+ * Map and fault in count regions of bytes each ahead of time, e.g. one per
+ * thread that will hash concurrently, so even the first hashes find memory ready.
+ */
+void
+blockPool_Reserve(size_t bytes, size_t count)
+{
+    pthread_mutex_lock(&blockPool.lock);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        _blockPool_AddRegion(bytes);
+    }
+    pthread_mutex_unlock(&blockPool.lock);
+}
+
+/**
+ * argon2_context.allocate_cbk: take the smallest free region that fits.
+ */
+int
+blockPool_Allocate(uint8_t **memory, size_t bytes)
+{
+    pthread_mutex_lock(&blockPool.lock);
+    BlockPoolRegion *best = NULL;
+    size_t i;
+    for (i = 0; i < blockPool.numRegions; i++) {
+        BlockPoolRegion *region = &blockPool.regions[i];
+        if (!region->inUse && region->capacity >= bytes && (best == NULL || region->capacity < best->capacity)) {
+            best = region;
+        }
+    }
+
+    if (best != NULL) {
+        blockPool.reused++;
+    } else {
+        best = _blockPool_AddRegion(bytes);
+    }
+    if (best != NULL) {
+        best->inUse = true;
+        *memory = best->memory;
+    }
+    pthread_mutex_unlock(&blockPool.lock);
+
+    return best != NULL ? ARGON2_OK : ARGON2_MEMORY_ALLOCATION_ERROR;
+}
+
+/**
+ * argon2_context.free_cbk: return the region to the pool without unmapping it.
+ */
+void
+blockPool_Free(uint8_t *memory, size_t bytes)
+{
+    pthread_mutex_lock(&blockPool.lock);
+    size_t i;
+    for (i = 0; i < blockPool.numRegions; i++) {
+        if (blockPool.regions[i].memory == memory) {
+            blockPool.regions[i].inUse = false;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&blockPool.lock);
+}
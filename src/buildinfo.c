@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+// The build configuration (type, compiler, flags, -march, LTO and PGO), as
+// composed by CMakeLists.txt, so every result can be traced to the binary
+// that produced it.
+
+#ifndef TSEC_BUILD_CONFIG
+#define TSEC_BUILD_CONFIG "unknown"
+#endif
+
+const char *
+buildInfo_Configuration(void)
+{
+    return TSEC_BUILD_CONFIG;
+}
+
+/**
+ * Print the build configuration on stderr as a "build: " line.
+ */
+void
+buildInfo_Report(void)
+{
+    fprintf(stderr, "build: %s\n", buildInfo_Configuration());
+}
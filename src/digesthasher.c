@@ -0,0 +1,126 @@
+#include <parc/algol/parc_Object.h>
+#include <parc/algol/parc_Memory.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Hashers driven directly instead of through PARCCryptoHasher, which wraps every
+// digest in a freshly allocated PARCCryptoHash. Here the digest is finished into
+// memory the caller owns, so a hash makes no allocations of its own. Each
+// backend's entry points are those of its PARCCryptoHasherInterface, with
+// FinalizeInto in place of Finalize. Every backend produces 32-byte digests.
+
+#define DIGEST_HASHER_LENGTH 32
+
+typedef struct {
+    void *(*hasher_setup)(void *env);
+    int (*hasher_init)(void *hasher);
+    int (*hasher_update)(void *hasher, const void *buffer, size_t length);
+    void (*hasher_finalize_into)(void *hasher, uint8_t *digest);
+} DigestHasherInterface;
+
+static const DigestHasherInterface functor_digest_sha256 = {
+    .hasher_setup = (void *(*)(void *)) sha256Hasher_Create,
+    .hasher_init = (int (*)(void *)) sha256Hasher_Init,
+    .hasher_update = (int (*)(void *, const void *, size_t)) sha256Hasher_Update,
+    .hasher_finalize_into = (void (*)(void *, uint8_t *)) sha256Hasher_FinalizeInto,
+};
+
+static const DigestHasherInterface functor_digest_argon2 = {
+    .hasher_setup = (void *(*)(void *)) argon2Hasher_Create,
+    .hasher_init = (int (*)(void *)) argon2Hasher_Init,
+    .hasher_update = (int (*)(void *, const void *, size_t)) argon2Hasher_Update,
+    .hasher_finalize_into = (void (*)(void *, uint8_t *)) argon2Hasher_FinalizeInto,
+};
+
+static const DigestHasherInterface functor_digest_scrypt = {
+    .hasher_setup = (void *(*)(void *)) scryptHasher_Create,
+    .hasher_init = (int (*)(void *)) scryptHasher_Init,
+    .hasher_update = (int (*)(void *, const void *, size_t)) scryptHasher_Update,
+    .hasher_finalize_into = (void (*)(void *, uint8_t *)) scryptHasher_FinalizeInto,
+};
+
+static const DigestHasherInterface functor_digest_balloon = {
+    .hasher_setup = (void *(*)(void *)) balloonHasher_Create,
+    .hasher_init = (int (*)(void *)) balloonHasher_Init,
+    .hasher_update = (int (*)(void *, const void *, size_t)) balloonHasher_Update,
+    .hasher_finalize_into = (void (*)(void *, uint8_t *)) balloonHasher_FinalizeInto,
+};
+
+typedef struct {
+    const DigestHasherInterface *interface;
+    PARCObject *instance;
+} DigestHasher;
+
+/**
+ * Create a hasher for hashAlgorithm, or NULL if it is not a known algorithm.
+ */
+DigestHasher *
+digestHasher_Create(HashType hashAlgorithm)
+{
+    const DigestHasherInterface *interface = NULL;
+    switch (hashAlgorithm) {
+        case HashType_SHA256:
+            interface = &functor_digest_sha256;
+            break;
+        case HashType_Argon2:
+            interface = &functor_digest_argon2;
+            break;
+        case HashType_Scrypt:
+            interface = &functor_digest_scrypt;
+            break;
+        case HashType_Balloon:
+            interface = &functor_digest_balloon;
+            break;
+        default:
+            return NULL;
+    }
+
+    DigestHasher *hasher = parcMemory_Allocate(sizeof(DigestHasher));
+    hasher->interface = interface;
+    hasher->instance = interface->hasher_setup(NULL);
+    return hasher;
+}
+
+void
+digestHasher_Release(DigestHasher **hasherPtr)
+{
+    parcObject_Release(&(*hasherPtr)->instance);
+    parcMemory_Deallocate(hasherPtr);
+}
+
+static inline int
+digestHasher_Init(DigestHasher *hasher)
+{
+    return hasher->interface->hasher_init(hasher->instance);
+}
+
+static inline int
+digestHasher_Update(DigestHasher *hasher, const void *buffer, size_t length)
+{
+    return hasher->interface->hasher_update(hasher->instance, buffer, length);
+}
+
+/**
+ * Write the digest of everything hashed since Init into digest, which must hold
+ * DIGEST_HASHER_LENGTH bytes.
+ */
+static inline void
+digestHasher_FinalizeInto(DigestHasher *hasher, uint8_t *digest)
+{
+    hasher->interface->hasher_finalize_into(hasher->instance, digest);
+}
+
+/**
+ * Hash length bytes of array into digest, which must hold DIGEST_HASHER_LENGTH
+ * bytes. Returns false if the backend rejected the hash, e.g. for costs below
+ * its minimum, in which case digest is not meaningful.
+ */
+static inline bool
+digestHasher_Hash(DigestHasher *hasher, const uint8_t *array, size_t length, uint8_t *digest)
+{
+    digestHasher_Init(hasher);
+    bool hashed = digestHasher_Update(hasher, array, length) >= 0;
+    digestHasher_FinalizeInto(hasher, digest);
+    return hashed;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Hash benchmarks: time one hash function over random inputs of a fixed
+// length, as obfuscate does for a range of lengths and single does for one
+// short input. Each trial hashes a fresh input with the cycle timer around the
+// hash alone. Latencies go into a histogram, and hardware counters, when
+// enabled, are read outside the timed interval.
+
+typedef struct {
+    size_t inputLength;
+    int trials;
+    uint64_t totalTime;
+    Histogram latency;
+    PerfSample counts;          // hardware counters summed over the trials
+} HashBenchResult;
+
+// The timed work: absorb the input and finish the digest into the caller's
+// buffer, which must hold DIGEST_HASHER_LENGTH bytes. Returns false if the
+// backend rejected the hash.
+bool
+hashFunction(DigestHasher *instance, PARCBuffer *buffer, uint8_t *digest)
+{
+    bool hashed = digestHasher_Update(instance, parcBuffer_Overlay(buffer, 0), parcBuffer_Remaining(buffer)) >= 0;
+    digestHasher_FinalizeInto(instance, digest);
+    return hashed;
+}
+
+/**
+ * Hash trials random inputs of inputLength bytes into result, which is
+ * overwritten. With progress, each trial is announced on stderr.
+ */
+void
+hashBench_Run(DigestHasher *hasher, PARCSecureRandom *random, size_t inputLength, int trials, bool progress,
+              HashBenchResult *result)
+{
+    memset(result, 0, sizeof(HashBenchResult));
+    result->inputLength = inputLength;
+    result->trials = trials;
+
+    uint8_t digest[DIGEST_HASHER_LENGTH];
+    PerfCounters counters;
+    bool counting = perfCounters_Enabled() && perfCounters_Open(&counters);
+
+    int t;
+    for (t = 0; t < trials; t++) {
+        if (progress) {
+            fprintf(stderr, "Trial %d\n", t);
+        }
+        // Generate the input buffer to be hashed
+        PARCBuffer *input = parcBuffer_Allocate(inputLength);
+        parcSecureRandom_NextBytes(random, input);
+        digestHasher_Init(hasher);
+
+        // Compute the hash of the input, reading the counters outside the timed interval
+        PerfSample before;
+        PerfSample after;
+        if (counting) {
+            perfCounters_Read(&counters, &before);
+        }
+        uint64_t startTime = cycleTimer_Start();
+        bool hashed = hashFunction(hasher, input, digest);
+        uint64_t endTime = cycleTimer_Stop();
+        if (counting) {
+            perfCounters_Read(&counters, &after);
+            perfSample_AddDelta(&result->counts, &before, &after);
+        }
+        assertTrue(hashed, "Expected the hash to succeed; check the cost parameters");
+
+        uint64_t time = cycleTimer_Nanos(startTime, endTime);
+        result->totalTime += time;
+        histogram_Record(&result->latency, time);
+
+        parcBuffer_Release(&input);
+    }
+
+    if (counting) {
+        perfCounters_Close(&counters);
+    }
+}
+
+double
+hashBenchResult_Mean(const HashBenchResult *result)
+{
+    return result->trials == 0 ? 0.0 : ((double) result->totalTime) / result->trials;
+}
@@ -0,0 +1,100 @@
+#include <pthread.h>
+#include <unistd.h>
+
+#include <stdint.h>
+
+// Cores set aside for memory-hard hashing, shared by every worker in the process.
+//
+// A multi-lane Argon2 hash runs its lanes on threads that argon2_ctx starts for
+// the duration of the call. Before hashing, a caller takes up to one core per
+// lane from the pool and passes what it got as the thread count, so the lanes of
+// concurrent hashes never add up to more threads than the pool has cores. A
+// caller always gets at least one core, waiting if necessary. The thread count
+// does not change the digest; only the lane count does.
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+    uint32_t total;
+    uint32_t available;
+} HashPool;
+
+static HashPool hashPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .released = PTHREAD_COND_INITIALIZER,
+    .total = 0,
+    .available = 0
+};
+
+static uint32_t
+_hashPool_OnlineCores(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (uint32_t) online : 1;
+}
+
+// Resize the pool with the lock held. Cores already handed out stay accounted
+// for: available moves by the change in total and never goes below zero.
+static void
+_hashPool_ResizeLocked(uint32_t cores)
+{
+    uint32_t inUse = hashPool.total - hashPool.available;
+    hashPool.total = cores;
+    hashPool.available = cores > inUse ? cores - inUse : 0;
+}
+
+/**
+ * Give the pool cores cores; 0 means every online CPU. Call before hashing starts.
+ */
+void
+hashPool_Configure(uint32_t cores)
+{
+    if (cores == 0) {
+        cores = _hashPool_OnlineCores();
+    }
+    pthread_mutex_lock(&hashPool.lock);
+    _hashPool_ResizeLocked(cores);
+    pthread_cond_broadcast(&hashPool.released);
+    pthread_mutex_unlock(&hashPool.lock);
+}
+
+/**
+ * Take between 1 and wanted cores, blocking while none are free. Returns the
+ * number taken, which must be handed back with hashPool_Release. An
+ * unconfigured pool is sized to the online CPUs on first use.
+ */
+uint32_t
+hashPool_Acquire(uint32_t wanted)
+{
+    pthread_mutex_lock(&hashPool.lock);
+    if (hashPool.total == 0) {
+        _hashPool_ResizeLocked(_hashPool_OnlineCores());
+    }
+    while (hashPool.available == 0) {
+        pthread_cond_wait(&hashPool.released, &hashPool.lock);
+    }
+    uint32_t granted = wanted < hashPool.available ? wanted : hashPool.available;
+    granted = granted == 0 ? 1 : granted;
+    hashPool.available -= granted;
+    pthread_mutex_unlock(&hashPool.lock);
+    return granted;
+}
+
+void
+hashPool_Release(uint32_t cores)
+{
+    pthread_mutex_lock(&hashPool.lock);
+    hashPool.available += cores;
+    if (hashPool.available > hashPool.total) {
+        // The pool shrank while these cores were out
+        hashPool.available = hashPool.total;
+    }
+    pthread_cond_broadcast(&hashPool.released);
+    pthread_mutex_unlock(&hashPool.lock);
+}
+
+uint32_t
+hashPool_Size(void)
+{
+    return hashPool.total;
+}
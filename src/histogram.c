@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Fixed-memory latency histogram in the style of HdrHistogram.
+//
+// Values below HISTOGRAM_SUB_BUCKETS get a bucket each. Above that, every power
+// of two is split into HISTOGRAM_SUB_BUCKETS / 2 linear buckets, so any 64-bit
+// value is recorded with a relative error under 1% in a constant 58 KB.
+// Recording is an index computation and an increment. An all-zero Histogram is
+// empty, so histograms can be embedded in zeroed structures without an init
+// call. The count, min, max, mean and variance are tracked exactly alongside.
+// A histogram is not synchronized; give each thread its own and merge them
+// with histogram_Add.
+
+#define HISTOGRAM_SUB_BUCKET_BITS 8
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (64 - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double mean;
+    double m2;              // sum of squared differences from the mean (Welford)
+} Histogram;
+
+static size_t
+_histogram_Index(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (size_t) value;
+    }
+    int shift = (63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    return HISTOGRAM_SUB_BUCKETS + (size_t) (shift - 1) * HISTOGRAM_HALF_BUCKETS +
+           (size_t) ((value >> shift) - HISTOGRAM_HALF_BUCKETS);
+}
+
+// The largest value that falls into bucket index
+static uint64_t
+_histogram_HighestValue(size_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    int shift = (int) ((index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_HALF_BUCKETS) + 1;
+    uint64_t top = (index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_HALF_BUCKETS + HISTOGRAM_HALF_BUCKETS;
+    if (shift + HISTOGRAM_SUB_BUCKET_BITS >= 64 && top == HISTOGRAM_SUB_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+    return ((top + 1) << shift) - 1;
+}
+
+void
+histogram_Record(Histogram *histogram, uint64_t value)
+{
+    histogram->counts[_histogram_Index(value)]++;
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->count++;
+
+    double delta = (double) value - histogram->mean;
+    histogram->mean += delta / histogram->count;
+    histogram->m2 += delta * ((double) value - histogram->mean);
+}
+
+/**
+ * Merge source into histogram.
+ */
+void
+histogram_Add(Histogram *histogram, const Histogram *source)
+{
+    if (source->count == 0) {
+        return;
+    }
+    size_t i;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        histogram->counts[i] += source->counts[i];
+    }
+    if (histogram->count == 0 || source->min < histogram->min) {
+        histogram->min = source->min;
+    }
+    if (source->max > histogram->max) {
+        histogram->max = source->max;
+    }
+
+    // Combine the moments of the two samples
+    double count = (double) histogram->count + source->count;
+    double delta = source->mean - histogram->mean;
+    histogram->m2 += source->m2 + delta * delta * histogram->count * source->count / count;
+    histogram->mean += delta * source->count / count;
+    histogram->count += source->count;
+}
+
+double
+histogram_Mean(const Histogram *histogram)
+{
+    return histogram->mean;
+}
+
+double
+histogram_StandardDeviation(const Histogram *histogram)
+{
+    return histogram->count > 1 ? sqrt(histogram->m2 / (histogram->count - 1)) : 0.0;
+}
+
+/**
+ * The value at or below which percentile percent of the recorded values fall,
+ * reported as the top of its bucket (never above the exact maximum).
+ */
+uint64_t
+histogram_Percentile(const Histogram *histogram, double percentile)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) ceil(percentile / 100.0 * histogram->count);
+    rank = rank < 1 ? 1 : rank;
+
+    uint64_t seen = 0;
+    size_t i;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t value = _histogram_HighestValue(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/**
+ * Write every non-empty bucket as "label,value,count,percentile" lines, where
+ * value is the top of the bucket and percentile is cumulative.
+ */
+void
+histogram_Dump(const Histogram *histogram, FILE *file, const char *label)
+{
+    uint64_t seen = 0;
+    size_t i;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (histogram->counts[i] > 0) {
+            seen += histogram->counts[i];
+            uint64_t value = _histogram_HighestValue(i);
+            fprintf(file, "%s,%llu,%llu,%f\n", label, (unsigned long long) (value < histogram->max ? value : histogram->max),
+                    (unsigned long long) histogram->counts[i], 100.0 * seen / histogram->count);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#include <parc/algol/parc_Object.h>
+#include <parc/algol/parc_Memory.h>
+
+#include <sodium.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Bounded cache of keys derived from names.
+//
+// The cache is set-associative: a name hashes (SipHash, keyed per cache) to one
+// set of KEY_CACHE_WAYS entries, and a miss evicts within that set using the
+// CLOCK policy, so memory is fixed at creation and lookups never chain. A cache
+// is not synchronized; give each thread its own.
+
+#define KEY_CACHE_KEY_LENGTH 32
+#define KEY_CACHE_WAYS 8
+
+typedef struct {
+    uint64_t hash;
+    uint8_t *name;          // copy of the name; grown as needed, reused on eviction
+    size_t nameLength;
+    size_t nameCapacity;
+    uint8_t key[KEY_CACHE_KEY_LENGTH];
+    bool valid;
+    bool referenced;
+} KeyCacheEntry;
+
+typedef struct {
+    KeyCacheEntry *entries;
+    size_t numSets;
+    uint8_t *hands;         // CLOCK hand per set
+    uint8_t hashKey[crypto_shorthash_KEYBYTES];
+
+    uint64_t hits;
+    uint64_t misses;
+} KeyCache;
+
+static bool
+_keyCache_Destructor(KeyCache **cachePtr)
+{
+    KeyCache *cache = *cachePtr;
+    size_t i;
+    for (i = 0; i < cache->numSets * KEY_CACHE_WAYS; i++) {
+        if (cache->entries[i].name != NULL) {
+            parcMemory_Deallocate(&cache->entries[i].name);
+        }
+        sodium_memzero(cache->entries[i].key, KEY_CACHE_KEY_LENGTH);
+    }
+    parcMemory_Deallocate(&cache->entries);
+    parcMemory_Deallocate(&cache->hands);
+    return true;
+}
+
+parcObject_Override(KeyCache, PARCObject,
+                    .destructor = (PARCObjectDestructor *) _keyCache_Destructor);
+
+parcObject_ImplementAcquire(keyCache, KeyCache);
+parcObject_ImplementRelease(keyCache, KeyCache);
+
+/**
+ * Create a cache holding at least capacity keys.
+ */
+KeyCache *
+keyCache_Create(size_t capacity)
+{
+    KeyCache *cache = parcObject_CreateInstance(KeyCache);
+    if (cache != NULL) {
+        cache->numSets = (capacity + KEY_CACHE_WAYS - 1) / KEY_CACHE_WAYS;
+        if (cache->numSets == 0) {
+            cache->numSets = 1;
+        }
+        cache->entries = parcMemory_AllocateAndClear(cache->numSets * KEY_CACHE_WAYS * sizeof(KeyCacheEntry));
+        cache->hands = parcMemory_AllocateAndClear(cache->numSets);
+        randombytes_buf(cache->hashKey, sizeof(cache->hashKey));
+        cache->hits = 0;
+        cache->misses = 0;
+    }
+    return cache;
+}
+
+static uint64_t
+_keyCache_Hash(const KeyCache *cache, const uint8_t *name, size_t length)
+{
+    uint64_t hash;
+    crypto_shorthash((unsigned char *) &hash, name, length, cache->hashKey);
+    return hash;
+}
+
+static KeyCacheEntry *
+_keyCache_Set(KeyCache *cache, uint64_t hash)
+{
+    return &cache->entries[(hash % cache->numSets) * KEY_CACHE_WAYS];
+}
+
+/**
+ * Return the cached key for name, or NULL on a miss. The pointer is valid until
+ * the next keyCache_Put on this cache.
+ */
+const uint8_t *
+keyCache_Get(KeyCache *cache, const uint8_t *name, size_t length)
+{
+    uint64_t hash = _keyCache_Hash(cache, name, length);
+    KeyCacheEntry *set = _keyCache_Set(cache, hash);
+
+    int way;
+    for (way = 0; way < KEY_CACHE_WAYS; way++) {
+        KeyCacheEntry *entry = &set[way];
+        if (entry->valid && entry->hash == hash && entry->nameLength == length && memcmp(entry->name, name, length) == 0) {
+            entry->referenced = true;
+            cache->hits++;
+            return entry->key;
+        }
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+/**
+ * Insert the key for name, evicting the first unreferenced entry in its set.
+ */
+void
+keyCache_Put(KeyCache *cache, const uint8_t *name, size_t length, const uint8_t key[KEY_CACHE_KEY_LENGTH])
+{
+    uint64_t hash = _keyCache_Hash(cache, name, length);
+    KeyCacheEntry *set = _keyCache_Set(cache, hash);
+    uint8_t *hand = &cache->hands[(hash % cache->numSets)];
+
+    // Sweep the hand, clearing reference bits, until it rests on a victim
+    KeyCacheEntry *victim = NULL;
+    while (victim == NULL) {
+        KeyCacheEntry *entry = &set[*hand];
+        if (!entry->valid || !entry->referenced) {
+            victim = entry;
+        } else {
+            entry->referenced = false;
+        }
+        *hand = (*hand + 1) % KEY_CACHE_WAYS;
+    }
+
+    if (victim->nameCapacity < length) {
+        if (victim->name != NULL) {
+            parcMemory_Deallocate(&victim->name);
+        }
+        victim->name = parcMemory_Allocate(length);
+        victim->nameCapacity = length;
+    }
+    memcpy(victim->name, name, length);
+    memcpy(victim->key, key, KEY_CACHE_KEY_LENGTH);
+    victim->nameLength = length;
+    victim->hash = hash;
+    victim->valid = true;
+    victim->referenced = false;
+}
@@ -0,0 +1,61 @@
+#include <sodium.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Deterministic salts for the memory-hard hashers.
+//
+// By default Argon2 draws a random salt per hash, so a prefix never obfuscates
+// the same way twice. Once a namespace secret is configured, the salt for an
+// input is instead a keyed BLAKE2b of that input under a key derived from the
+// secret: every holder of the secret recomputes identical digests, outsiders
+// still cannot precompute them, and distinct prefixes never share a salt.
+
+#define KEYED_SALT_KEY_LENGTH crypto_generichash_KEYBYTES
+
+static bool keyedSaltEnabled = false;
+static uint8_t keyedSaltKey[KEYED_SALT_KEY_LENGTH];
+
+/**
+ * Derive salts from secret from now on. Call before any hashers are used.
+ */
+void
+keyedSalt_Configure(const uint8_t *secret, size_t length)
+{
+    crypto_generichash(keyedSaltKey, sizeof(keyedSaltKey), secret, length, NULL, 0);
+    keyedSaltEnabled = true;
+}
+
+bool
+keyedSalt_Enabled(void)
+{
+    return keyedSaltEnabled;
+}
+
+/**
+ * Fill salt (at least crypto_generichash_BYTES_MIN bytes) with the salt for input.
+ */
+void
+keyedSalt_Derive(const uint8_t *input, size_t length, uint8_t *salt, size_t saltLength)
+{
+    crypto_generichash(salt, saltLength, input, length, keyedSaltKey, sizeof(keyedSaltKey));
+}
+
+/**
+ * A 64-bit value identifying the configured secret without revealing it, or 0
+ * when salts are random.
+ */
+uint64_t
+keyedSalt_Fingerprint(void)
+{
+    uint64_t fingerprint = 0;
+    if (keyedSaltEnabled) {
+        const char *label = "tsec keyed salt fingerprint";
+        uint8_t digest[crypto_generichash_BYTES_MIN];
+        crypto_generichash(digest, sizeof(digest), (const uint8_t *) label, strlen(label),
+                           keyedSaltKey, sizeof(keyedSaltKey));
+        memcpy(&fingerprint, digest, sizeof(fingerprint));
+    }
+    return fingerprint;
+}
@@ -0,0 +1,429 @@
+#include <parc/algol/parc_Object.h>
+#include <parc/algol/parc_Buffer.h>
+#include <parc/algol/parc_Memory.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Flat, open-addressing map from obfuscated names to original encoded names.
+//
+// Each entry's obfuscated name and original name are copied back to back into
+// an append-only arena of fixed-size chunks and referenced by offset. An
+// obfuscated name ends with the digest of the whole name, so a slot keeps that
+// digest's leading bytes, mixed with the length, inline as its hash, along with
+// the name length and the arena offset. Probes compare those inline fields and
+// only read the arena to confirm a match against the full stored name, so names
+// whose final digests coincide (e.g. /a/bc and /ab/c) remain distinct entries.
+//
+// A table can be saved to disk and later mapped read-only with nameTable_Load.
+// The file is the header below, the slot array, then the arena chunks laid out
+// back to back, so slot offsets are valid in the file without translation.
+
+#define NAME_TABLE_CHUNK_SIZE (1 << 20)
+#define NAME_TABLE_MIN_CAPACITY 16
+#define NAME_TABLE_DIGEST_LENGTH 32
+
+typedef struct {
+    uint64_t hash;
+    uint32_t nameLength;    // length of the obfuscated name; 0 marks an empty slot
+    uint32_t valueLength;
+    uint64_t offset;        // the obfuscated name, immediately followed by the value
+} NameTableSlot;
+
+#define NAME_TABLE_FILE_MAGIC "TSECNTBL"
+#define NAME_TABLE_FILE_VERSION 3
+#define NAME_TABLE_FILE_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t reserved;
+    uint32_t slotSize;
+    uint64_t chunkSize;
+    uint64_t parameters;    // opaque to the table; identifies how the names were obfuscated
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t slotsOffset;
+    uint64_t arenaOffset;
+    uint64_t arenaLength;
+} NameTableFileHeader;
+
+typedef struct {
+    NameTableSlot *slots;
+    size_t capacity;        // always a power of two
+    size_t size;
+
+    uint8_t **chunks;
+    size_t numChunks;
+    size_t maxChunks;
+    size_t chunkUsed;
+
+    void *mapping;          // non-NULL when the table is a read-only view of a file
+    size_t mappingLength;
+} NameTable;
+
+static bool
+_nameTable_Destructor(NameTable **tablePtr)
+{
+    NameTable *table = *tablePtr;
+    if (table->mapping != NULL) {
+        munmap(table->mapping, table->mappingLength);
+    } else {
+        size_t i;
+        for (i = 0; i < table->numChunks; i++) {
+            parcMemory_Deallocate(&table->chunks[i]);
+        }
+        parcMemory_Deallocate(&table->slots);
+    }
+    if (table->chunks != NULL) {
+        parcMemory_Deallocate(&table->chunks);
+    }
+    return true;
+}
+
+parcObject_Override(NameTable, PARCObject,
+                    .destructor = (PARCObjectDestructor *) _nameTable_Destructor);
+
+parcObject_ImplementAcquire(nameTable, NameTable);
+parcObject_ImplementRelease(nameTable, NameTable);
+
+NameTable *
+nameTable_Create(size_t expectedEntries)
+{
+    NameTable *table = parcObject_CreateInstance(NameTable);
+    if (table != NULL) {
+        // Keep the load factor at or below one half
+        table->capacity = NAME_TABLE_MIN_CAPACITY;
+        while (table->capacity < expectedEntries * 2) {
+            table->capacity <<= 1;
+        }
+        table->slots = parcMemory_AllocateAndClear(table->capacity * sizeof(NameTableSlot));
+        table->size = 0;
+
+        table->chunks = NULL;
+        table->numChunks = 0;
+        table->maxChunks = 0;
+        table->chunkUsed = NAME_TABLE_CHUNK_SIZE;
+
+        table->mapping = NULL;
+        table->mappingLength = 0;
+    }
+    return table;
+}
+
+static uint64_t
+_nameTable_Hash(const uint8_t *obfuscatedName, size_t length)
+{
+    // The first 8 bytes of the final digest are already uniform; a name without
+    // segments is shorter than a digest and uses the bytes it has
+    uint64_t hash = 0;
+    size_t start = length >= NAME_TABLE_DIGEST_LENGTH ? length - NAME_TABLE_DIGEST_LENGTH : 0;
+    memcpy(&hash, obfuscatedName + start, length - start < sizeof(hash) ? length - start : sizeof(hash));
+    return hash ^ (uint64_t) length;
+}
+
+static const uint8_t *
+_nameTable_Bytes(const NameTable *table, uint64_t offset)
+{
+    return table->chunks[offset / NAME_TABLE_CHUNK_SIZE] + offset % NAME_TABLE_CHUNK_SIZE;
+}
+
+// The slot holding obfuscatedName, or the empty slot where it would be inserted
+static NameTableSlot *
+_nameTable_Find(const NameTable *table, uint64_t hash, const uint8_t *obfuscatedName, size_t obfuscatedLength)
+{
+    size_t index = (size_t) hash & (table->capacity - 1);
+    while (table->slots[index].nameLength != 0) {
+        const NameTableSlot *slot = &table->slots[index];
+        if (slot->hash == hash && slot->nameLength == obfuscatedLength
+            && memcmp(_nameTable_Bytes(table, slot->offset), obfuscatedName, obfuscatedLength) == 0) {
+            break;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+    return &table->slots[index];
+}
+
+static void
+_nameTable_Grow(NameTable *table)
+{
+    size_t capacity = table->capacity << 1;
+    NameTableSlot *slots = parcMemory_AllocateAndClear(capacity * sizeof(NameTableSlot));
+
+    // Entries are already distinct, so each one only needs an empty slot
+    size_t i;
+    for (i = 0; i < table->capacity; i++) {
+        if (table->slots[i].nameLength != 0) {
+            size_t index = (size_t) table->slots[i].hash & (capacity - 1);
+            while (slots[index].nameLength != 0) {
+                index = (index + 1) & (capacity - 1);
+            }
+            slots[index] = table->slots[i];
+        }
+    }
+
+    parcMemory_Deallocate(&table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+static uint64_t
+_nameTable_Store(NameTable *table, const uint8_t *obfuscatedName, size_t obfuscatedLength, const uint8_t *name, size_t valueLength)
+{
+    size_t length = obfuscatedLength + valueLength;
+    if (table->chunkUsed + length > NAME_TABLE_CHUNK_SIZE) {
+        if (table->numChunks == table->maxChunks) {
+            size_t maxChunks = table->maxChunks == 0 ? 8 : table->maxChunks * 2;
+            uint8_t **chunks = parcMemory_AllocateAndClear(maxChunks * sizeof(uint8_t *));
+            if (table->chunks != NULL) {
+                memcpy(chunks, table->chunks, table->numChunks * sizeof(uint8_t *));
+                parcMemory_Deallocate(&table->chunks);
+            }
+            table->chunks = chunks;
+            table->maxChunks = maxChunks;
+        }
+        table->chunks[table->numChunks++] = parcMemory_AllocateAndClear(NAME_TABLE_CHUNK_SIZE);
+        table->chunkUsed = 0;
+    }
+
+    uint64_t offset = (uint64_t) (table->numChunks - 1) * NAME_TABLE_CHUNK_SIZE + table->chunkUsed;
+    memcpy(table->chunks[table->numChunks - 1] + table->chunkUsed, obfuscatedName, obfuscatedLength);
+    memcpy(table->chunks[table->numChunks - 1] + table->chunkUsed + obfuscatedLength, name, valueLength);
+    table->chunkUsed += length;
+    return offset;
+}
+
+/**
+ * Map an obfuscated name to its original encoded name. Both names are copied
+ * into the table; an existing mapping for the same obfuscated name is replaced.
+ */
+void
+nameTable_PutArray(NameTable *table, const uint8_t *obfuscatedName, size_t obfuscatedLength, const uint8_t *name, size_t valueLength)
+{
+    assertNull(table->mapping, "A mapped name table is read-only");
+    assertTrue(obfuscatedLength > 0, "Obfuscated names must not be empty");
+    assertTrue(obfuscatedLength + valueLength <= NAME_TABLE_CHUNK_SIZE,
+               "Names of %zu bytes exceed the arena chunk size", obfuscatedLength + valueLength);
+
+    if ((table->size + 1) * 2 > table->capacity) {
+        _nameTable_Grow(table);
+    }
+
+    uint64_t hash = _nameTable_Hash(obfuscatedName, obfuscatedLength);
+    NameTableSlot *slot = _nameTable_Find(table, hash, obfuscatedName, obfuscatedLength);
+    if (slot->nameLength == 0) {
+        slot->hash = hash;
+        slot->nameLength = (uint32_t) obfuscatedLength;
+        table->size++;
+    } else if (slot->valueLength == valueLength &&
+               memcmp(_nameTable_Bytes(table, slot->offset) + slot->nameLength, name, valueLength) == 0) {
+        // Re-inserting the same mapping, e.g. on a repeated pass: keep the stored copy
+        return;
+    }
+    slot->valueLength = (uint32_t) valueLength;
+    slot->offset = _nameTable_Store(table, obfuscatedName, obfuscatedLength, name, valueLength);
+}
+
+void
+nameTable_Put(NameTable *table, PARCBuffer *obfuscatedName, PARCBuffer *name)
+{
+    nameTable_PutArray(table, parcBuffer_Overlay(obfuscatedName, 0), parcBuffer_Remaining(obfuscatedName),
+                       parcBuffer_Overlay(name, 0), parcBuffer_Remaining(name));
+}
+
+/**
+ * Look up the original name for an obfuscated name without copying or wrapping
+ * it. Returns a pointer into the table's storage, valid for the lifetime of the
+ * table, and its length in *valueLength; NULL if there is no mapping.
+ */
+const uint8_t *
+nameTable_Lookup(NameTable *table, const uint8_t *obfuscatedName, size_t obfuscatedLength, size_t *valueLength)
+{
+    if (obfuscatedLength == 0) {
+        return NULL;
+    }
+
+    uint64_t hash = _nameTable_Hash(obfuscatedName, obfuscatedLength);
+    NameTableSlot *slot = _nameTable_Find(table, hash, obfuscatedName, obfuscatedLength);
+    if (slot->nameLength == 0) {
+        return NULL;
+    }
+
+    *valueLength = slot->valueLength;
+    return _nameTable_Bytes(table, slot->offset) + slot->nameLength;
+}
+
+/**
+ * Look up the original name for an obfuscated name. The result wraps the table's
+ * own storage without copying and must be released by the caller; it remains
+ * valid for the lifetime of the table. Returns NULL if there is no mapping.
+ */
+PARCBuffer *
+nameTable_Get(NameTable *table, PARCBuffer *obfuscatedName)
+{
+    size_t valueLength = 0;
+    const uint8_t *value = nameTable_Lookup(table, parcBuffer_Overlay(obfuscatedName, 0), parcBuffer_Remaining(obfuscatedName), &valueLength);
+    if (value == NULL) {
+        return NULL;
+    }
+
+    return parcBuffer_Wrap((void *) value, valueLength, 0, valueLength);
+}
+
+size_t
+nameTable_Size(const NameTable *table)
+{
+    return table->size;
+}
+
+/**
+ * Serialize the table to path. parameters is stored verbatim in the header and
+ * returned by nameTable_Load. Returns false if the file could not be written.
+ */
+bool
+nameTable_Save(const NameTable *table, const char *path, uint64_t parameters)
+{
+    NameTableFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NAME_TABLE_FILE_MAGIC, sizeof(header.magic));
+    header.version = NAME_TABLE_FILE_VERSION;
+    header.byteOrder = NAME_TABLE_FILE_BYTE_ORDER;
+    header.slotSize = sizeof(NameTableSlot);
+    header.chunkSize = NAME_TABLE_CHUNK_SIZE;
+    header.parameters = parameters;
+    header.capacity = table->capacity;
+    header.size = table->size;
+    header.slotsOffset = sizeof(NameTableFileHeader);
+    header.arenaOffset = header.slotsOffset + table->capacity * sizeof(NameTableSlot);
+    header.arenaLength = table->numChunks == 0 ? 0 : (table->numChunks - 1) * NAME_TABLE_CHUNK_SIZE + table->chunkUsed;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    success = success && fwrite(table->slots, sizeof(NameTableSlot), table->capacity, file) == table->capacity;
+
+    size_t i;
+    for (i = 0; success && i < table->numChunks; i++) {
+        size_t length = (i == table->numChunks - 1) ? table->chunkUsed : NAME_TABLE_CHUNK_SIZE;
+        success = fwrite(table->chunks[i], 1, length, file) == length;
+    }
+
+    return (fclose(file) == 0) && success;
+}
+
+// Check everything a lookup will trust before the file is used: the header
+// fields, that the slot array and arena lie inside the file without overflow,
+// and that every occupied slot references a run inside the arena that does not
+// straddle a chunk boundary.
+static bool
+_nameTable_ValidFile(const NameTableFileHeader *header, size_t fileSize)
+{
+    if (memcmp(header->magic, NAME_TABLE_FILE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != NAME_TABLE_FILE_VERSION
+        || header->byteOrder != NAME_TABLE_FILE_BYTE_ORDER
+        || header->slotSize != sizeof(NameTableSlot)
+        || header->chunkSize != NAME_TABLE_CHUNK_SIZE) {
+        return false;
+    }
+
+    uint64_t capacity = header->capacity;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || header->size > capacity / 2) {
+        return false;
+    }
+    if (header->slotsOffset < sizeof(NameTableFileHeader)
+        || header->slotsOffset % sizeof(uint64_t) != 0
+        || capacity > (UINT64_MAX - header->slotsOffset) / sizeof(NameTableSlot)
+        || header->slotsOffset + capacity * sizeof(NameTableSlot) > header->arenaOffset
+        || header->arenaOffset > fileSize
+        || header->arenaLength > fileSize - header->arenaOffset) {
+        return false;
+    }
+
+    const NameTableSlot *slots = (const NameTableSlot *) ((const uint8_t *) header + header->slotsOffset);
+    uint64_t occupied = 0;
+    uint64_t i;
+    for (i = 0; i < capacity; i++) {
+        const NameTableSlot *slot = &slots[i];
+        if (slot->nameLength == 0) {
+            continue;
+        }
+        uint64_t length = (uint64_t) slot->nameLength + slot->valueLength;
+        if (slot->offset > header->arenaLength
+            || length > header->arenaLength - slot->offset
+            || slot->offset % NAME_TABLE_CHUNK_SIZE + length > NAME_TABLE_CHUNK_SIZE) {
+            return false;
+        }
+        occupied++;
+    }
+    return occupied == header->size;
+}
+
+/**
+ * Map a table written by nameTable_Save read-only. Nothing is copied; pages are
+ * faulted in as lookups touch them, except that every slot is read once up front
+ * to validate it. Returns NULL if the file is missing, truncated, corrupt, or was
+ * written with an incompatible format.
+ */
+NameTable *
+nameTable_Load(const char *path, uint64_t *parameters)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(NameTableFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t mappingLength = (size_t) status.st_size;
+    void *mapping = mmap(NULL, mappingLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    const NameTableFileHeader *header = (const NameTableFileHeader *) mapping;
+    if (!_nameTable_ValidFile(header, mappingLength)) {
+        munmap(mapping, mappingLength);
+        return NULL;
+    }
+
+    // Lookups land on random slots, so readahead only wastes page cache
+    madvise(mapping, mappingLength, MADV_RANDOM);
+
+    NameTable *table = parcObject_CreateInstance(NameTable);
+    table->mapping = mapping;
+    table->mappingLength = mappingLength;
+    table->slots = (NameTableSlot *) ((uint8_t *) mapping + header->slotsOffset);
+    table->capacity = header->capacity;
+    table->size = header->size;
+
+    table->numChunks = (header->arenaLength + NAME_TABLE_CHUNK_SIZE - 1) / NAME_TABLE_CHUNK_SIZE;
+    table->maxChunks = table->numChunks;
+    table->chunks = NULL;
+    if (table->numChunks > 0) {
+        table->chunks = parcMemory_Allocate(table->numChunks * sizeof(uint8_t *));
+        size_t i;
+        for (i = 0; i < table->numChunks; i++) {
+            table->chunks[i] = (uint8_t *) mapping + header->arenaOffset + i * NAME_TABLE_CHUNK_SIZE;
+        }
+    }
+    table->chunkUsed = NAME_TABLE_CHUNK_SIZE;
+
+    if (parameters != NULL) {
+        *parameters = header->parameters;
+    }
+    return table;
+}
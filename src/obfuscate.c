@@ -10,16 +10,27 @@
 #include <parc/security/parc_CryptoHasher.h>
 #include <parc/security/parc_SecureRandom.h>
 
+#include "keyedsalt.c"
+#include "hashpool.c"
+#include "blockpool.c"
 #include "argon2.c"
 #include "scrypt.c"
 #include "sha256.c"
-//#include "balloon.c"
+#include "balloon.c"
+#include "cycletimer.c"
+#include "perfcounters.c"
+#include "buildinfo.c"
+#include "histogram.c"
+#include "benchoptions.c"
+#include "digesthasher.c"
+#include "hashbench.c"
 
 #define NUM_TRIALS 100
 
 typedef struct {
     int length;
     double averageTime;
+    PerfSample counts;      // hardware counters summed over the trials
 } StatsEntry;
 
 static bool
@@ -46,58 +57,34 @@ statsEntry_Create(int n, double time)
 void
 usage(char *prog)
 {
-    fprintf(stderr, "%s <alg> <low> <high>", prog);
+    fprintf(stderr, "%s <low> <high> <alg> [t m [lanes [pool]] | N r p | s t d threads]\n", prog);
+    fprintf(stderr, "   alg = SHA256, ARGON2, scrypt or BALLOON\n");
+    fprintf(stderr, "   TSEC_PERF_COUNTERS=1 appends hash cycles, instructions, llc_misses, dtlb_misses and\n");
+    fprintf(stderr, "   branch_misses totals, then the same counts per hash, to each row\n");
     // XXX: print the other parts of the message
 }
 
-PARCBuffer *
-hashFunction(PARCCryptoHasher *instance, PARCBuffer *buffer)
-{
-    parcCryptoHasher_UpdateBuffer(instance, buffer);
-    PARCCryptoHash *hash = parcCryptoHasher_Finalize(instance);
-    PARCBuffer *digest = parcBuffer_Acquire(parcCryptoHash_GetDigest(hash));
-    parcCryptoHash_Release(&hash);
-    return digest;
-}
-
 PARCLinkedList *
-profileObfuscationFunction(PARCCryptoHasher *hasher, int low, int high)
+profileObfuscationFunction(DigestHasher *hasher, int low, int high)
 {
-    int i, t;
+    int i;
     PARCLinkedList *results = parcLinkedList_Create();
 
     PARCSecureRandom *random = parcSecureRandom_Create();
+    HashBenchResult *result = parcMemory_Allocate(sizeof(HashBenchResult));
 
     // Compute an average time for each input size
     for (i = low; i <= high; i++) {
-        // Compute an average value for this one entry
-        PARCStopwatch *timer = parcStopwatch_Create();
-        parcStopwatch_Start(timer);
-        uint64_t totalTime = 0;
-        for (t = 0; t < NUM_TRIALS; t++) {
-            // Generate the input buffer to be hashed
-            PARCBuffer *input = parcBuffer_Allocate(i);
-            parcSecureRandom_NextBytes(random, input);
-            parcCryptoHasher_Init(hasher);
-            //fprintf(stderr, "Hashing %d %d\n", i, t);
-
-            // Compute the hash of the input
-            uint64_t startTime = parcStopwatch_ElapsedTimeNanos(timer);
-            PARCBuffer *output = hashFunction(hasher, input);
-            uint64_t endTime = parcStopwatch_ElapsedTimeNanos(timer);
-            totalTime += (endTime - startTime);
-
-            parcBuffer_Release(&output);
-            parcBuffer_Release(&input);
-        }
-        parcStopwatch_Release(&timer);
+        hashBench_Run(hasher, random, i, NUM_TRIALS, false, result);
 
         // Append the results
-        double average = ((double) totalTime) / NUM_TRIALS;
-        StatsEntry *entry = statsEntry_Create(i, average);
+        StatsEntry *entry = statsEntry_Create(i, hashBenchResult_Mean(result));
+        entry->counts = result->counts;
         parcLinkedList_Append(results, entry);
     }
 
+    parcMemory_Deallocate(&result);
+    parcSecureRandom_Release(&random);
     return results;
 }
 
@@ -107,47 +94,51 @@ processResults(char *alg, PARCLinkedList *results)
     PARCIterator *iterator = parcLinkedList_CreateIterator(results);
     while (parcIterator_HasNext(iterator)) {
         StatsEntry *entry = (StatsEntry *) parcIterator_Next(iterator);
-        printf("%s,%d,%f\n", alg, entry->length, entry->averageTime);
+        printf("%s,%d,%f", alg, entry->length, entry->averageTime);
+        if (perfCounters_Enabled()) {
+            perfSample_PrintCSV(stdout, &entry->counts, NUM_TRIALS);
+        }
+        printf("\n");
     }
 }
 
 int
 main(int argc, char **argv)
 {
+    buildInfo_Report();
     if (argc < 4) {
         usage(argv[0]);
         exit(-1);
     }
 
     argon2_init();
-
-    // printf("%d %d\n", crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE);
+    balloon_init();
+    cycleTimer_Init();
+    perfCounters_Configure(getenv("TSEC_PERF_COUNTERS") != NULL);
 
     // extract the parameters
     int low = atoi(argv[1]);
     int high = atoi(argv[2]);
     char *alg = argv[3];
-    argon2TCost = atoi(argv[4]);
-    argon2MCost = atoi(argv[5]);
-
-    // Create the statically allocated hashers
-    PARCCryptoHasher *sha256Hasher = parcCryptoHasher_CustomHasher(0, functor_sha256);
-    PARCCryptoHasher *argon2Hasher = parcCryptoHasher_CustomHasher(0, functor_argon2);
-    PARCCryptoHasher *scryptHasher = parcCryptoHasher_CustomHasher(0, functor_scrypt);
-
-    // switch on the algorithm
-    PARCCryptoHasher *hasher;
-    if (strcmp(alg, "SHA256") == 0) {
-        hasher = sha256Hasher;
-    } else if (strcmp(alg, "ARGON2") == 0) {
-        hasher = argon2Hasher;
-    } else if (strcmp(alg, "scrypt") == 0) {
-        hasher = scryptHasher;
-    } else {
+    int hashAlgorithm = benchOptions_ParseHash(argc - 3, argv + 3);
+    if (hashAlgorithm < 0) {
         usage(argv[0]);
         exit(-2);
     }
+    if (hashAlgorithm == HashType_Argon2 && argc > 7) {
+        // "prefault" or "huge": reuse pre-faulted Argon2 block memory across hashes
+        if (strcmp(argv[7], "prefault") != 0 && strcmp(argv[7], "huge") != 0) {
+            fprintf(stderr, "Block pool mode %s is unknown\n", argv[7]);
+            usage(argv[0]);
+            exit(-2);
+        }
+        blockPool_Configure(strcmp(argv[7], "huge") == 0);
+        blockPool_Reserve(argon2MCost, 1);
+    }
 
+    DigestHasher *hasher = digestHasher_Create(hashAlgorithm);
     PARCLinkedList *results = profileObfuscationFunction(hasher, low, high);
+    digestHasher_Release(&hasher);
     processResults(alg, results);
+    perfCounters_ReportMissing();
 }
@@ -0,0 +1,294 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Hardware performance counters around pipeline stages, via perf_event_open.
+//
+// Each thread opens one counter group for itself: cycles, instructions,
+// last-level cache misses, dTLB misses and branch misses, user space only so
+// the default perf_event_paranoid setting allows it. A stage is bracketed by two
+// group reads and the difference is added to that stage's PerfSample. Events the
+// CPU or hypervisor does not provide are left out of the group and reported as
+// missing instead of failing the run. When the PMU has more events to count
+// than counters, e.g. under a hypervisor or alongside other perf users, the
+// kernel multiplexes the group and it only counts part of the time; samples keep
+// how long the group was enabled and running, and counts are scaled up by that
+// ratio. A group read is a system call, so callers read the counters outside
+// their timed intervals. Counting is opt-in with perfCounters_Configure.
+// perf_event_open is Linux only; elsewhere counting stays off and
+// perfCounters_Open always fails.
+
+typedef enum {
+    PerfEvent_Cycles,
+    PerfEvent_Instructions,
+    PerfEvent_LLCMisses,
+    PerfEvent_DTLBMisses,
+    PerfEvent_BranchMisses,
+    PerfEvent_Count
+} PerfEvent;
+
+static const char *perfEventNames[PerfEvent_Count] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"
+};
+
+typedef struct {
+    uint64_t values[PerfEvent_Count];
+    uint64_t enabled;               // ns the group was enabled
+    uint64_t running;               // ns it was actually counting; less than enabled when multiplexed
+} PerfSample;
+
+typedef struct {
+    int leader;                     // group leader, -1 when nothing could be opened
+    int fds[PerfEvent_Count];
+    int slots[PerfEvent_Count];     // position in a group read, -1 if not counted
+    int numOpen;
+} PerfCounters;
+
+static bool perfCountersEnabled = false;
+static uint32_t perfCountersMissing = 0;    // bit per PerfEvent that some thread could not open
+static uint32_t perfCountersScaled = 0;     // nonzero once some interval was multiplexed
+
+void
+perfCounters_Configure(bool enabled)
+{
+#ifdef __linux__
+    perfCountersEnabled = enabled;
+#else
+    if (enabled) {
+        fprintf(stderr, "perf counters need perf_event_open, which is Linux only; counting is off\n");
+    }
+#endif
+}
+
+bool
+perfCounters_Enabled(void)
+{
+    return perfCountersEnabled;
+}
+
+#ifdef __linux__
+static int
+_perfCounters_OpenEvent(uint32_t type, uint64_t config, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+#define PERF_COUNTERS_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/**
+ * Start counting for the calling thread. Returns false if no event could be
+ * opened, in which case reads leave samples at zero.
+ */
+bool
+perfCounters_Open(PerfCounters *counters)
+{
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[PerfEvent_Count] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNTERS_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HW_CACHE, PERF_COUNTERS_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+
+    counters->leader = -1;
+    counters->numOpen = 0;
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        counters->fds[i] = _perfCounters_OpenEvent(events[i].type, events[i].config, counters->leader);
+        if (counters->fds[i] < 0) {
+            counters->slots[i] = -1;
+            __sync_fetch_and_or(&perfCountersMissing, 1u << i);
+            continue;
+        }
+        if (counters->leader < 0) {
+            counters->leader = counters->fds[i];
+        }
+        counters->slots[i] = counters->numOpen++;
+    }
+    return counters->leader >= 0;
+}
+#else
+bool
+perfCounters_Open(PerfCounters *counters)
+{
+    counters->leader = -1;
+    counters->numOpen = 0;
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        counters->fds[i] = -1;
+        counters->slots[i] = -1;
+    }
+    return false;
+}
+#endif
+
+void
+perfCounters_Close(PerfCounters *counters)
+{
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+    counters->leader = -1;
+}
+
+/**
+ * Read the running totals of every counter in the group, and the group's
+ * enabled and running times.
+ */
+void
+perfCounters_Read(const PerfCounters *counters, PerfSample *sample)
+{
+    // nr, time_enabled, time_running, then one value per counter
+    uint64_t buffer[3 + PerfEvent_Count];
+    memset(sample, 0, sizeof(*sample));
+    if (counters->leader < 0 || read(counters->leader, buffer, sizeof(buffer)) < (ssize_t) (3 * sizeof(uint64_t))) {
+        return;
+    }
+    sample->enabled = buffer[1];
+    sample->running = buffer[2];
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (counters->slots[i] >= 0 && (uint64_t) counters->slots[i] < buffer[0]) {
+            sample->values[i] = buffer[3 + counters->slots[i]];
+        }
+    }
+}
+
+/**
+ * Add the counts and times between two reads, before and after, to total.
+ */
+void
+perfSample_AddDelta(PerfSample *total, const PerfSample *before, const PerfSample *after)
+{
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        total->values[i] += after->values[i] - before->values[i];
+    }
+    uint64_t enabled = after->enabled - before->enabled;
+    uint64_t running = after->running - before->running;
+    if (running < enabled) {
+        __sync_fetch_and_or(&perfCountersScaled, 1);
+    }
+    total->enabled += enabled;
+    total->running += running;
+}
+
+void
+perfSample_Add(PerfSample *total, const PerfSample *part)
+{
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        total->values[i] += part->values[i];
+    }
+    total->enabled += part->enabled;
+    total->running += part->running;
+}
+
+/**
+ * The count of event in sample, scaled by enabled/running time if the group was
+ * multiplexed. Returns false if the event was not counted, or the group never
+ * ran while it was enabled so there is nothing to scale.
+ */
+bool
+perfSample_Value(const PerfSample *sample, PerfEvent event, double *value)
+{
+    if (perfCountersMissing & (1u << event)) {
+        return false;
+    }
+    if (sample->running < sample->enabled) {
+        if (sample->running == 0) {
+            return false;
+        }
+        *value = (double) sample->values[event] * sample->enabled / sample->running;
+    } else {
+        *value = (double) sample->values[event];
+    }
+    return true;
+}
+
+/**
+ * Append ",total" for every event and then ",total/count" for every event,
+ * leaving the field empty for events that were not counted.
+ */
+void
+perfSample_PrintCSV(FILE *file, const PerfSample *total, uint64_t count)
+{
+    double value;
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (perfSample_Value(total, (PerfEvent) i, &value)) {
+            fprintf(file, ",%.0f", value);
+        } else {
+            fprintf(file, ",");
+        }
+    }
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (count > 0 && perfSample_Value(total, (PerfEvent) i, &value)) {
+            fprintf(file, ",%f", value / count);
+        } else {
+            fprintf(file, ",");
+        }
+    }
+}
+
+/**
+ * Append ",event=total,event_per_name=average" for every event that was counted.
+ */
+void
+perfSample_PrintFields(FILE *file, const PerfSample *total, uint64_t count)
+{
+    double value;
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (perfSample_Value(total, (PerfEvent) i, &value)) {
+            fprintf(file, ",%s=%.0f,%s_per_name=%f", perfEventNames[i], value,
+                    perfEventNames[i], count == 0 ? 0.0 : value / count);
+        }
+    }
+}
+
+/**
+ * Tell the user on stderr whether counts were scaled, and which events could not
+ * be counted, if any.
+ */
+void
+perfCounters_ReportMissing(void)
+{
+    if (perfCountersScaled) {
+        fprintf(stderr, "perf counters were multiplexed; counts are scaled by enabled/running time\n");
+    }
+    if (perfCountersMissing == 0) {
+        return;
+    }
+    fprintf(stderr, "perf counters not available:");
+    int i;
+    for (i = 0; i < PerfEvent_Count; i++) {
+        if (perfCountersMissing & (1u << i)) {
+            fprintf(stderr, " %s", perfEventNames[i]);
+        }
+    }
+    fprintf(stderr, "\n");
+}
@@ -0,0 +1,1518 @@
+#include <parc/algol/parc_SafeMemory.h>
+#include <parc/algol/parc_BufferComposer.h>
+#include <parc/algol/parc_LinkedList.h>
+#include <parc/algol/parc_Iterator.h>
+
+#include <parc/developer/parc_Stopwatch.h>
+#include <parc/security/parc_SecureRandom.h>
+
+#include <ccnx/common/ccnx_Name.h>
+#include <ccnx/common/codec/ccnxCodec_TlvEncoder.h>
+#include <ccnx/common/codec/schema_v1/ccnxCodecSchemaV1_Types.h>
+#include <ccnx/common/codec/schema_v1/ccnxCodecSchemaV1_NameCodec.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sodium.h>
+
+#include "keyedsalt.c"
+#include "hashpool.c"
+#include "blockpool.c"
+#include "argon2.c"
+#include "scrypt.c"
+#include "balloon.c"
+#include "sha256.c"
+#include "sha256mb.c"
+#include "nametable.c"
+#include "keycache.c"
+#include "stream.c"
+#include "aead.c"
+#include "uriloader.c"
+#include "uriname.c"
+#include "arena.c"
+#include "prefixtrie.c"
+#include "throughput.c"
+#include "histogram.c"
+#include "cycletimer.c"
+#include "perfcounters.c"
+#include "buildinfo.c"
+#include "benchoptions.c"
+#include "digesthasher.c"
+
+// Content cipher, chosen once at startup. Sealed content is a single
+// wire-ready payload: nonce || ciphertext || tag
+static const AEADInterface *contentCipher = &functor_chacha20poly1305;
+
+#define TSEC_NONCE_LENGTH (contentCipher->nonceLength)
+#define TSEC_TAG_LENGTH (contentCipher->tagLength)
+#define TSEC_PAYLOAD_OVERHEAD (TSEC_NONCE_LENGTH + TSEC_TAG_LENGTH)
+
+static size_t dataSizes[] = {1024, 2048, 4096, 8192};
+static int numDataSizes = sizeof(dataSizes) / sizeof(size_t);
+
+static size_t
+maxDataSize()
+{
+    size_t max = 0;
+    int i;
+    for (i = 0; i < numDataSizes; i++) {
+        max = dataSizes[i] > max ? dataSizes[i] : max;
+    }
+    return max;
+}
+
+static int
+randomDataSize()
+{
+    uint32_t randomWord = randombytes_random();
+    return dataSizes[randomWord % numDataSizes];
+}
+
+// When set, SHA-256 prefix digests are computed from a running context that only
+// absorbs each new segment, instead of re-hashing the whole prefix per segment.
+static bool chainedPrefixHashing = false;
+
+// Every hasher used for obfuscation produces 32-byte digests
+#define TSEC_DIGEST_LENGTH DIGEST_HASHER_LENGTH
+
+// Each segment of an encoded name costs at least its 4-byte TLV header
+#define TSEC_MAX_SEGMENTS (URI_NAME_MAX_LENGTH / 4 + 1)
+
+// Per-thread scratch for the segment values of one name, sized for the largest
+// name a 16-bit TLV length allows. It is too big for a worker thread's stack.
+typedef struct {
+    uint8_t values[URI_NAME_MAX_LENGTH];
+    size_t ends[TSEC_MAX_SEGMENTS];
+    uint16_t types[TSEC_MAX_SEGMENTS];
+} TSecNameScratch;
+
+// Split an encoded name into its segment values, laid back to back in values so
+// that values[0, ends[i]) is the prefix ending with segment i. Only the bytes
+// covered by the name's 16-bit TLV length are read, so values never needs more
+// than URI_NAME_MAX_LENGTH bytes and ends and types TSEC_MAX_SEGMENTS entries;
+// smaller names need encodedLength bytes and encodedLength / 4 + 1 entries.
+// Returns the number of segments.
+static int
+_splitEncodedName(const uint8_t *encoded, size_t encodedLength, uint16_t *nameType, uint8_t *values, size_t *ends, uint16_t *types)
+{
+    size_t length = 0;
+    *nameType = 0;
+    if (encodedLength < 4) {
+        return 0;
+    }
+    uriName_GetHeader(encoded, nameType, &length);
+    if (length > encodedLength - 4) {
+        length = encodedLength - 4;
+    }
+
+    const uint8_t *segments = encoded + 4;
+    size_t offset = 0;
+    size_t valueLength = 0;
+    int count = 0;
+    while (offset + 4 <= length) {
+        size_t innerLength = 0;
+        uriName_GetHeader(segments + offset, &types[count], &innerLength);
+        offset += 4;
+        if (innerLength > length - offset) {
+            break;
+        }
+        memcpy(values + valueLength, segments + offset, innerLength);
+        valueLength += innerLength;
+        offset += innerLength;
+        ends[count++] = valueLength;
+    }
+    return count;
+}
+
+// An obfuscated name is never longer than this for an encoded name of length bytes
+#define TSEC_OBFUSCATED_LENGTH_BOUND(length) (4 + ((length) / 4) * (4 + TSEC_DIGEST_LENGTH))
+
+// The most segments whose obfuscated name still has a 16-bit TLV length
+#define TSEC_MAX_OBFUSCATED_SEGMENTS (URI_NAME_MAX_LENGTH / (4 + TSEC_DIGEST_LENGTH))
+
+// Write the obfuscated name into output: each segment is replaced by the digest
+// of the prefix ending with it. types may be NULL when every segment is a plain
+// name segment. With a trie, digests of prefixes seen before are copied from it
+// and new ones are recorded. count must not exceed TSEC_MAX_OBFUSCATED_SEGMENTS.
+// Returns the number of bytes written, 4 + count * (4 + TSEC_DIGEST_LENGTH).
+static size_t
+_obfuscateSegmentsInto(DigestHasher *hasher, PrefixTrie *trie, uint16_t nameType, const uint8_t *values,
+                       const size_t *ends, const uint16_t *types, int count, uint8_t *output)
+{
+    // The running context lags behind after trie hits and catches up on the next miss
+    CTX_SHA256 prefixContext;
+    size_t hashedLength = 0;
+    if (chainedPrefixHashing) {
+        INIT_SHA256(&prefixContext);
+    }
+
+    uint32_t node = PREFIX_TRIE_ROOT;
+    size_t position = 4;
+    size_t start = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        uint16_t type = types != NULL ? types[i] : URI_NAME_SEGMENT_TYPE;
+        uint8_t *digest = output + position + 4;
+        uriName_PutHeader(output + position, type, TSEC_DIGEST_LENGTH);
+
+        bool found = false;
+        if (trie != NULL) {
+            node = prefixTrie_Child(trie, node, type, values + start, ends[i] - start, &found);
+        }
+
+        // Compute the hash of the prefix ending with this segment
+        if (found) {
+            memcpy(digest, prefixTrie_Digest(trie, node), TSEC_DIGEST_LENGTH);
+        } else {
+            if (chainedPrefixHashing) {
+                UPDATE_SHA256(&prefixContext, values + hashedLength, (unsigned) (ends[i] - hashedLength));
+                hashedLength = ends[i];
+                CTX_SHA256 snapshot = prefixContext;
+                FINAL_SHA256(digest, &snapshot);
+            } else {
+                bool hashed = digestHasher_Hash(hasher, values, ends[i], digest);
+                assertTrue(hashed, "Expected the prefix hash to succeed");
+            }
+            if (trie != NULL) {
+                memcpy(prefixTrie_Digest(trie, node), digest, TSEC_DIGEST_LENGTH);
+            }
+        }
+
+        position += 4 + TSEC_DIGEST_LENGTH;
+        start = ends[i];
+    }
+
+    uriName_PutHeader(output, nameType, position - 4);
+    return position;
+}
+
+// Build the obfuscated name in one exactly-sized buffer
+static PARCBuffer *
+_obfuscateSegments(DigestHasher *hasher, PrefixTrie *trie, uint16_t nameType, const uint8_t *values,
+                   const size_t *ends, const uint16_t *types, int count)
+{
+    PARCBuffer *obfuscatedName = parcBuffer_Allocate(4 + (size_t) count * (4 + TSEC_DIGEST_LENGTH));
+    _obfuscateSegmentsInto(hasher, trie, nameType, values, ends, types, count, parcBuffer_Overlay(obfuscatedName, 0));
+    return obfuscatedName;
+}
+
+// Obfuscate an encoded name into output, which must hold
+// TSEC_OBFUSCATED_LENGTH_BOUND(encodedLength) bytes. Returns the length written.
+static size_t
+_obfuscateNameInto(DigestHasher *hasher, PrefixTrie *trie, TSecNameScratch *scratch,
+                   const uint8_t *encoded, size_t encodedLength, uint8_t *output)
+{
+    uint16_t nameType;
+    int count = _splitEncodedName(encoded, encodedLength, &nameType, scratch->values, scratch->ends, scratch->types);
+
+    return _obfuscateSegmentsInto(hasher, trie, nameType, scratch->values, scratch->ends, scratch->types, count, output);
+}
+
+// Obfuscate an encoded name by walking its TLV in place; the segment values and
+// their prefixes live in the caller's scratch, so the only allocation is the output.
+static PARCBuffer *
+_obfuscateName(DigestHasher *hasher, PrefixTrie *trie, TSecNameScratch *scratch, PARCBuffer *encodedName)
+{
+    const uint8_t *encoded = parcBuffer_Overlay(encodedName, 0);
+    size_t encodedLength = parcBuffer_Remaining(encodedName);
+
+    uint16_t nameType;
+    int count = _splitEncodedName(encoded, encodedLength, &nameType, scratch->values, scratch->ends, scratch->types);
+
+    return _obfuscateSegments(hasher, trie, nameType, scratch->values, scratch->ends, scratch->types, count);
+}
+
+// Encode the first N segments of a URI in a single pass, and obfuscate them too
+// when obfuscatedName is not NULL. Both outputs match the CCNxName path. Returns
+// false, producing nothing, for URIs that need the full name parser, including
+// those too long for the 16-bit TLV lengths.
+static bool
+_encodeURI(DigestHasher *hasher, PrefixTrie *trie, TSecNameScratch *scratch, const uint8_t *uri, size_t uriLength,
+           int N, PARCBuffer **encodedName, PARCBuffer **obfuscatedName)
+{
+    int count = uriName_Parse(uri, uriLength, N, scratch->values, scratch->ends);
+    if (count < 0) {
+        return false;
+    }
+
+    *encodedName = parcBuffer_Allocate(uriName_EncodedLength(count, scratch->ends));
+    uriName_Encode(count, scratch->values, scratch->ends, parcBuffer_Overlay(*encodedName, 0));
+
+    if (obfuscatedName != NULL) {
+        *obfuscatedName = _obfuscateSegments(hasher, trie, CCNxCodecSchemaV1Types_CCNxMessage_Name,
+                                             scratch->values, scratch->ends, NULL, count);
+    }
+    return true;
+}
+
+// Encode a URI through CCNxName, for the labeled and unusual URIs that
+// _encodeURI declines. Returns NULL if the URI does not parse.
+static PARCBuffer *
+_encodeURIWithName(const uint8_t *uri, size_t uriLength, int N)
+{
+    // Wrap the line in place; the mapping outlives the name parse
+    PARCBuffer *bufferString = parcBuffer_Wrap((void *) uri, uriLength, 0, uriLength);
+
+    // Create the original name and store it for later
+    //fprintf(stderr, "Parsing: %s\n", parcBuffer_ToString(bufferString));
+    CCNxName *name = ccnxName_CreateFromBuffer(bufferString);
+    parcBuffer_Release(&bufferString);
+    if (name == NULL) {
+        return NULL;
+    }
+
+    // Trim the name if necessary
+    if (ccnxName_GetSegmentCount(name) > N) {
+        size_t delta = ccnxName_GetSegmentCount(name) - N;
+        name = ccnxName_Trim(name, delta);
+    }
+
+    CCNxCodecTlvEncoder *encoder = ccnxCodecTlvEncoder_Create();
+    ccnxCodecSchemaV1NameCodec_Encode(encoder, CCNxCodecSchemaV1Types_CCNxMessage_Name, name);
+    ccnxCodecTlvEncoder_Finalize(encoder);
+    PARCBuffer *encodedBuffer = ccnxCodecTlvEncoder_CreateBuffer(encoder);
+    ccnxCodecTlvEncoder_Destroy(&encoder);
+
+    ccnxName_Release(&name);
+    return encodedBuffer;
+}
+
+// Obfuscate count encoded SHA-256 names at once. The prefixes of every name are
+// gathered into one job list and hashed together by the multi-buffer kernel, so
+// independent prefixes fill the SIMD lanes. Output matches _obfuscateName.
+static void
+_obfuscateNameBatch(PARCBuffer **encodedNames, size_t count, PARCBuffer **obfuscatedNames)
+{
+    size_t totalLength = 0;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        totalLength += parcBuffer_Remaining(encodedNames[i]);
+    }
+
+    // Each segment costs at least a 4-byte TLV header, which bounds the number of prefixes
+    size_t maxJobs = totalLength / 4 + 1;
+    uint8_t *scratch = parcMemory_Allocate(totalLength + 1);
+    uint8_t *digests = parcMemory_Allocate(maxJobs * LENGTH_SHA256);
+    uint16_t *segmentTypes = parcMemory_Allocate(maxJobs * sizeof(uint16_t));
+    size_t *ends = parcMemory_Allocate(maxJobs * sizeof(size_t));
+    SHA256MultiBufferJob *jobs = parcMemory_Allocate(maxJobs * sizeof(SHA256MultiBufferJob));
+    size_t *firstJob = parcMemory_Allocate((count + 1) * sizeof(size_t));
+    uint16_t *nameTypes = parcMemory_Allocate(count * sizeof(uint16_t));
+
+    // 1. Lay out every prefix of every name as a job over the shared scratch array
+    size_t numJobs = 0;
+    size_t scratchOffset = 0;
+    for (i = 0; i < count; i++) {
+        uint8_t *nameValues = scratch + scratchOffset;
+        int segments = _splitEncodedName(parcBuffer_Overlay(encodedNames[i], 0), parcBuffer_Remaining(encodedNames[i]),
+                                         &nameTypes[i], nameValues, ends, segmentTypes + numJobs);
+
+        firstJob[i] = numJobs;
+        int j;
+        for (j = 0; j < segments; j++) {
+            jobs[numJobs].data = nameValues;
+            jobs[numJobs].length = ends[j];
+            jobs[numJobs].digest = digests + numJobs * LENGTH_SHA256;
+            numJobs++;
+        }
+        scratchOffset += segments > 0 ? ends[segments - 1] : 0;
+    }
+    firstJob[count] = numJobs;
+
+    // 2. Hash all prefixes in SIMD lanes
+    sha256MultiBuffer_Hash(jobs, numJobs);
+
+    // 3. Emit the obfuscated names
+    for (i = 0; i < count; i++) {
+        size_t segments = firstJob[i + 1] - firstJob[i];
+        obfuscatedNames[i] = parcBuffer_Allocate(4 + segments * (4 + LENGTH_SHA256));
+        uint8_t *output = parcBuffer_Overlay(obfuscatedNames[i], 0);
+        size_t position = 4;
+        size_t j;
+        for (j = firstJob[i]; j < firstJob[i + 1]; j++) {
+            uriName_PutHeader(output + position, segmentTypes[j], LENGTH_SHA256);
+            memcpy(output + position + 4, jobs[j].digest, LENGTH_SHA256);
+            position += 4 + LENGTH_SHA256;
+        }
+        uriName_PutHeader(output, nameTypes[i], position - 4);
+    }
+
+    parcMemory_Deallocate(&nameTypes);
+    parcMemory_Deallocate(&firstJob);
+    parcMemory_Deallocate(&jobs);
+    parcMemory_Deallocate(&ends);
+    parcMemory_Deallocate(&segmentTypes);
+    parcMemory_Deallocate(&digests);
+    parcMemory_Deallocate(&scratch);
+}
+
+// The obfuscated-to-original name table is split into independently locked
+// shards so concurrent workers only contend when they hit the same shard.
+#define TSEC_TABLE_SHARDS 64
+
+// A table may instead be backed by a prebuilt, read-only file mapping, in which
+// case inserts are skipped and lookups need no locking.
+typedef struct {
+    NameTable *shards[TSEC_TABLE_SHARDS];
+    pthread_mutex_t locks[TSEC_TABLE_SHARDS];
+    uint64_t contended;
+    NameTable *prebuilt;
+} TSecReverseTable;
+
+static TSecReverseTable *
+_reverseTable_Create(size_t expectedEntries)
+{
+    TSecReverseTable *table = parcMemory_AllocateAndClear(sizeof(TSecReverseTable));
+    int i;
+    for (i = 0; i < TSEC_TABLE_SHARDS; i++) {
+        table->shards[i] = nameTable_Create(expectedEntries / TSEC_TABLE_SHARDS);
+        pthread_mutex_init(&table->locks[i], NULL);
+    }
+    return table;
+}
+
+static void
+_reverseTable_Release(TSecReverseTable **tablePtr)
+{
+    TSecReverseTable *table = *tablePtr;
+    int i;
+    for (i = 0; i < TSEC_TABLE_SHARDS; i++) {
+        nameTable_Release(&table->shards[i]);
+        pthread_mutex_destroy(&table->locks[i]);
+    }
+    if (table->prebuilt != NULL) {
+        nameTable_Release(&table->prebuilt);
+    }
+    parcMemory_Deallocate(tablePtr);
+}
+
+static size_t
+_reverseTable_Shard(const uint8_t *obfuscatedName, size_t length)
+{
+    // The last byte belongs to the final prefix digest, so it spreads names evenly
+    if (length > 0) {
+        return obfuscatedName[length - 1] % TSEC_TABLE_SHARDS;
+    }
+    return 0;
+}
+
+static void
+_reverseTable_Lock(TSecReverseTable *table, size_t shard)
+{
+    if (pthread_mutex_trylock(&table->locks[shard]) != 0) {
+        __sync_fetch_and_add(&table->contended, 1);
+        pthread_mutex_lock(&table->locks[shard]);
+    }
+}
+
+static void
+_reverseTable_PutArray(TSecReverseTable *table, const uint8_t *obfuscatedName, size_t obfuscatedLength,
+                       const uint8_t *name, size_t nameLength)
+{
+    if (table->prebuilt != NULL) {
+        return;
+    }
+
+    size_t shard = _reverseTable_Shard(obfuscatedName, obfuscatedLength);
+    _reverseTable_Lock(table, shard);
+    nameTable_PutArray(table->shards[shard], obfuscatedName, obfuscatedLength, name, nameLength);
+    pthread_mutex_unlock(&table->locks[shard]);
+}
+
+static void
+_reverseTable_Put(TSecReverseTable *table, PARCBuffer *obfuscatedName, PARCBuffer *name)
+{
+    _reverseTable_PutArray(table, parcBuffer_Overlay(obfuscatedName, 0), parcBuffer_Remaining(obfuscatedName),
+                           parcBuffer_Overlay(name, 0), parcBuffer_Remaining(name));
+}
+
+// Look up an original name in place. Table storage is append-only, so the
+// result stays valid after the shard lock is dropped.
+static const uint8_t *
+_reverseTable_Lookup(TSecReverseTable *table, const uint8_t *obfuscatedName, size_t obfuscatedLength, size_t *nameLength)
+{
+    if (table->prebuilt != NULL) {
+        return nameTable_Lookup(table->prebuilt, obfuscatedName, obfuscatedLength, nameLength);
+    }
+
+    size_t shard = _reverseTable_Shard(obfuscatedName, obfuscatedLength);
+    _reverseTable_Lock(table, shard);
+    const uint8_t *name = nameTable_Lookup(table->shards[shard], obfuscatedName, obfuscatedLength, nameLength);
+    pthread_mutex_unlock(&table->locks[shard]);
+    return name;
+}
+
+static PARCBuffer *
+_reverseName(TSecReverseTable *table, PARCBuffer *buffer)
+{
+    if (table->prebuilt != NULL) {
+        return nameTable_Get(table->prebuilt, buffer);
+    }
+
+    size_t shard = _reverseTable_Shard(parcBuffer_Overlay(buffer, 0), parcBuffer_Remaining(buffer));
+    _reverseTable_Lock(table, shard);
+    PARCBuffer *name = nameTable_Get(table->shards[shard], buffer);
+    pthread_mutex_unlock(&table->locks[shard]);
+    return name;
+}
+
+/**
+ * Seal plaintextLength bytes into payload, which must hold plaintextLength + TSEC_PAYLOAD_OVERHEAD
+ * bytes. Sealing in place is allowed when plaintext == payload + TSEC_NONCE_LENGTH.
+ */
+static bool
+_sealPlaintext(uint8_t *payload, const uint8_t *plaintext, size_t plaintextLength, const uint8_t *key)
+{
+    uint8_t *nonce = payload;
+    uint8_t *ciphertext = payload + TSEC_NONCE_LENGTH;
+    uint8_t *tag = ciphertext + plaintextLength;
+
+    // XXX: maybe add packet metadata as AAD later
+    const uint8_t *aad = NULL;
+    size_t aadLength = 0;
+
+    randombytes_buf(nonce, TSEC_NONCE_LENGTH);
+
+    unsigned long long tagLength = 0;
+    int result = contentCipher->aead_encrypt(ciphertext, tag, &tagLength,
+                                             plaintext, plaintextLength, aad, aadLength,
+                                             NULL, nonce, key);
+    return result == 0;
+}
+
+/**
+ * Open a payload produced by _sealPlaintext into plaintext, which must hold
+ * payloadLength - TSEC_PAYLOAD_OVERHEAD bytes. Opening in place is allowed when
+ * plaintext == payload + TSEC_NONCE_LENGTH.
+ */
+static bool
+_openCiphertext(uint8_t *plaintext, const uint8_t *payload, size_t payloadLength, const uint8_t *key)
+{
+    if (payloadLength < TSEC_PAYLOAD_OVERHEAD) {
+        return false;
+    }
+
+    const uint8_t *nonce = payload;
+    const uint8_t *ciphertext = payload + TSEC_NONCE_LENGTH;
+    size_t ciphertextLength = payloadLength - TSEC_PAYLOAD_OVERHEAD;
+    const uint8_t *tag = ciphertext + ciphertextLength;
+
+    const uint8_t *aad = NULL;
+    size_t aadLength = 0;
+
+    int result = contentCipher->aead_decrypt(plaintext, NULL, ciphertext,
+                                             ciphertextLength, tag, aad,
+                                             aadLength, nonce, key);
+    return result == 0;
+}
+
+#define TSEC_KEY_LENGTH KEY_CACHE_KEY_LENGTH
+
+// Per-thread key derivation state: a SHA-256 hasher reused across misses and an
+// optional cache of previously derived keys.
+typedef struct {
+    DigestHasher *hasher;
+    KeyCache *cache;
+} TSecKeyContext;
+
+static void
+_deriveKey(TSecKeyContext *context, const uint8_t *name, size_t nameLength, uint8_t key[TSEC_KEY_LENGTH])
+{
+    if (context->cache != NULL) {
+        const uint8_t *cachedKey = keyCache_Get(context->cache, name, nameLength);
+        if (cachedKey != NULL) {
+            memcpy(key, cachedKey, TSEC_KEY_LENGTH);
+            return;
+        }
+    }
+
+    uint8_t nameDigest[DIGEST_HASHER_LENGTH];
+    bool hashed = digestHasher_Hash(context->hasher, name, nameLength, nameDigest);
+    assertTrue(hashed, "Expected the name hash to succeed");
+
+    uint8_t keyid[crypto_generichash_blake2b_SALTBYTES] = {0};
+    uint8_t appid[crypto_generichash_blake2b_PERSONALBYTES] = {0};
+
+    crypto_generichash_blake2b_salt_personal(key, TSEC_KEY_LENGTH,
+                                            NULL, 0,
+                                            nameDigest, sizeof(nameDigest),
+                                            keyid, appid);
+
+    if (context->cache != NULL) {
+        keyCache_Put(context->cache, name, nameLength, key);
+    }
+}
+
+static void
+_deriveKeyFromName(TSecKeyContext *context, PARCBuffer *nameBuffer, uint8_t key[TSEC_KEY_LENGTH])
+{
+    _deriveKey(context, parcBuffer_Overlay(nameBuffer, 0), parcBuffer_Remaining(nameBuffer), key);
+}
+
+static PARCBuffer *
+_createRandomBuffer(PARCSecureRandom *rng, int size)
+{
+    PARCBuffer *buffer = parcBuffer_Allocate(size);
+    parcSecureRandom_NextBytes(rng, buffer);
+    return buffer;
+}
+
+static PARCBuffer *
+_encryptContent(TSecKeyContext *keyContext, PARCBuffer *name, PARCBuffer *data)
+{
+    // 1. Derive the key from the name
+    uint8_t key[TSEC_KEY_LENGTH];
+    _deriveKeyFromName(keyContext, name, key);
+
+    // 2. Seal the content, with a fresh nonce, into one payload buffer
+    size_t dataLength = parcBuffer_Remaining(data);
+    PARCBuffer *payload = parcBuffer_Allocate(dataLength + TSEC_PAYLOAD_OVERHEAD);
+    bool sealed = _sealPlaintext(parcBuffer_Overlay(payload, 0), parcBuffer_Overlay(data, 0), dataLength, key);
+
+    sodium_memzero(key, sizeof(key));
+    if (!sealed) {
+        parcBuffer_Release(&payload);
+    }
+
+    return payload;
+}
+
+/**
+ * Decrypt payload into the caller's plaintext buffer, which is cleared and then
+ * limited to the recovered content length. Returns false if authentication fails
+ * or the content does not fit.
+ */
+static bool
+_decryptContent(TSecKeyContext *keyContext, PARCBuffer *name, PARCBuffer *payload, PARCBuffer *plaintext)
+{
+    size_t payloadLength = parcBuffer_Remaining(payload);
+    if (payloadLength < TSEC_PAYLOAD_OVERHEAD || payloadLength - TSEC_PAYLOAD_OVERHEAD > parcBuffer_Capacity(plaintext)) {
+        return false;
+    }
+
+    uint8_t key[TSEC_KEY_LENGTH];
+    _deriveKeyFromName(keyContext, name, key);
+    parcBuffer_Clear(plaintext);
+    bool opened = _openCiphertext(parcBuffer_Overlay(plaintext, 0), parcBuffer_Overlay(payload, 0), payloadLength, key);
+    parcBuffer_SetLimit(plaintext, payloadLength - TSEC_PAYLOAD_OVERHEAD);
+    sodium_memzero(key, sizeof(key));
+    return opened;
+}
+
+typedef struct {
+    uint64_t obfuscateTime;
+    uint64_t deobfuscateTime;
+    uint64_t encryptTime;
+    uint64_t decryptTime;
+    size_t payloadLength;
+} TSecStatsEntry;
+
+// Latencies are recorded per stage into fixed-size histograms as each name
+// completes, so a run keeps no per-name state
+typedef enum {
+    TSecStage_Obfuscate,
+    TSecStage_Deobfuscate,
+    TSecStage_Encrypt,
+    TSecStage_Decrypt,
+    TSecStage_Count
+} TSecStage;
+
+static const char *tsecStageNames[TSecStage_Count] = { "obfuscate", "deobfuscate", "encrypt", "decrypt" };
+
+static void
+_tsecStats_Record(Histogram *latency, const TSecStatsEntry *entry)
+{
+    histogram_Record(&latency[TSecStage_Obfuscate], entry->obfuscateTime);
+    histogram_Record(&latency[TSecStage_Deobfuscate], entry->deobfuscateTime);
+    histogram_Record(&latency[TSecStage_Encrypt], entry->encryptTime);
+    histogram_Record(&latency[TSecStage_Decrypt], entry->decryptTime);
+}
+
+/**
+ * Write the full per-stage histograms to path as "stage,value,count,percentile" lines.
+ */
+static bool
+dumpHistograms(const Histogram *latency, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+    int stage;
+    for (stage = 0; stage < TSecStage_Count; stage++) {
+        histogram_Dump(&latency[stage], file, tsecStageNames[stage]);
+    }
+    return fclose(file) == 0;
+}
+
+
+// Identifies the obfuscation settings a table file was built with. Memory-hard
+// digests also depend on the cost settings and the namespace secret, which are
+// folded into the otherwise unused top bits.
+static uint64_t
+_tableParameters(HashType hashAlgorithm, int N)
+{
+    uint64_t parameters = ((uint64_t) hashAlgorithm << 32) | (uint32_t) N;
+    if (hashAlgorithm != HashType_SHA256) {
+        uint64_t settings[4] = {(uint64_t) argon2TCost, (uint64_t) argon2MCost, (uint64_t) argon2DCost, keyedSalt_Fingerprint()};
+        if (hashAlgorithm == HashType_Scrypt) {
+            settings[0] = (uint64_t) scrypt_N;
+            settings[1] = (uint64_t) scrypt_r;
+            settings[2] = (uint64_t) scrypt_p;
+        } else if (hashAlgorithm == HashType_Balloon) {
+            settings[0] = (uint64_t) balloonSCost;
+            settings[1] = (uint64_t) balloonTCost;
+            settings[2] = ((uint64_t) balloonNeighbors << 32) | (uint32_t) balloonThreads;
+        }
+        uint8_t digest[crypto_generichash_BYTES_MIN];
+        uint64_t fingerprint;
+        crypto_generichash(digest, sizeof(digest), (const uint8_t *) settings, sizeof(settings), NULL, 0);
+        memcpy(&fingerprint, digest, sizeof(fingerprint));
+        parameters |= fingerprint & 0xFFFFFF0000000000ULL;
+    }
+    return parameters;
+}
+
+// Offline step: obfuscate every name in the URI file and write the reverse table
+// to path. Plain URIs go straight to their encoded and obfuscated forms.
+static int
+_buildTableFile(HashType hashAlgorithm, int N, URILoader *loader, const char *path, bool memoize)
+{
+    DigestHasher *hasher = digestHasher_Create(hashAlgorithm);
+    NameTable *table = nameTable_Create(1024);
+    PrefixTrie *trie = memoize ? prefixTrie_Create(1024) : NULL;
+    TSecNameScratch *scratch = parcMemory_Allocate(sizeof(TSecNameScratch));
+
+    const uint8_t *uri = NULL;
+    size_t uriLength = 0;
+    while (uriLoader_Next(loader, &uri, &uriLength)) {
+        PARCBuffer *encodedName = NULL;
+        PARCBuffer *obfuscatedName = NULL;
+        if (!_encodeURI(hasher, trie, scratch, uri, uriLength, N, &encodedName, &obfuscatedName)) {
+            encodedName = _encodeURIWithName(uri, uriLength, N);
+            if (encodedName == NULL) {
+                continue;
+            }
+            obfuscatedName = _obfuscateName(hasher, trie, scratch, encodedName);
+        }
+        nameTable_Put(table, obfuscatedName, encodedName);
+        parcBuffer_Release(&obfuscatedName);
+        parcBuffer_Release(&encodedName);
+    }
+
+    bool saved = nameTable_Save(table, path, _tableParameters(hashAlgorithm, N));
+    if (saved) {
+        fprintf(stderr, "Wrote %zu names to %s\n", nameTable_Size(table), path);
+    } else {
+        perror("Could not write table file");
+    }
+    if (trie != NULL) {
+        fprintf(stderr, "prefix memo: %zu unique prefixes, hit rate %f\n", prefixTrie_Size(trie), prefixTrie_HitRate(trie));
+        prefixTrie_Release(&trie);
+    }
+
+    parcMemory_Deallocate(&scratch);
+    nameTable_Release(&table);
+    digestHasher_Release(&hasher);
+    return saved ? 0 : -1;
+}
+
+// Each worker runs the pipeline over names [start, end) with its own hasher, RNG
+// and latency histograms; only the reverse table is shared.
+typedef struct {
+    PARCBuffer **names;
+    PARCBuffer **batchNames;
+    uint64_t *batchTimes;
+    size_t start;
+    size_t end;
+    int N;
+
+    TSecReverseTable *table;
+    DigestHasher *hasher;
+    PARCSecureRandom *rng;
+    PARCBuffer *plaintext;      // decryption output, reused for every name
+    TSecKeyContext keyContext;
+    Histogram latency[TSecStage_Count];
+    bool counting;              // hardware counters are open for this thread
+    PerfCounters counters;
+    PerfSample counts[TSecStage_Count];
+    Arena *arena;               // per-name scratch memory; NULL to use the heap
+    PrefixTrie *trie;           // memoized prefix digests; NULL to hash every prefix
+    TSecNameScratch *scratch;   // segment values of the name being obfuscated
+    volatile bool *stopped;     // set when the run is abandoned; checked before each name
+
+    // Streamed mode: objects of streamObjectSize bytes sealed in streamChunkSize chunks
+    size_t streamObjectSize;
+    size_t streamChunkSize;
+    uint8_t *streamPlaintext;
+    uint8_t *streamCiphertext;
+    uint8_t *streamOutput;
+
+    // Throughput mode: cycle through the range until quota names are done or the
+    // deadline passes, accumulating into throughput instead of stats
+    bool sustained;
+    uint64_t quota;
+    uint64_t deadline;          // throughput_MonotonicNanos(); UINT64_MAX for none
+    double offeredLoad;         // names/sec for this worker; 0 for back to back
+    Throughput throughput;
+} TSecWorker;
+
+// Hardware counters are read just outside the timed brackets, so the read
+// system calls stay out of the latencies
+static inline void
+_tsecWorker_CountBegin(TSecWorker *worker, PerfSample *before)
+{
+    if (worker->counting) {
+        perfCounters_Read(&worker->counters, before);
+    }
+}
+
+static inline void
+_tsecWorker_CountEnd(TSecWorker *worker, TSecStage stage, const PerfSample *before)
+{
+    if (worker->counting) {
+        PerfSample after;
+        perfCounters_Read(&worker->counters, &after);
+        perfSample_AddDelta(&worker->counts[stage], before, &after);
+    }
+}
+
+// Encrypt and decrypt one streamed object chunk by chunk, as a producer and a
+// consumer would, so memory stays bounded by a single chunk regardless of the
+// object size. Each chunk is opened as soon as it is sealed. Only the seal and
+// open work (including key derivation) is charged to the two times.
+static bool
+_streamContent(TSecWorker *worker, PARCBuffer *name, uint64_t *encryptTime, uint64_t *decryptTime)
+{
+    uint8_t header[STREAM_HEADER_LENGTH];
+    uint8_t key[TSEC_KEY_LENGTH];
+    StreamCipher sealer;
+    StreamCipher opener;
+    PerfSample counted;
+    bool success = true;
+
+    _tsecWorker_CountBegin(worker, &counted);
+    uint64_t start = cycleTimer_Start();
+    _deriveKeyFromName(&worker->keyContext, name, key);
+    success = success && streamCipher_InitSeal(&sealer, header, key);
+    sodium_memzero(key, sizeof(key));
+    *encryptTime = cycleTimer_Nanos(start, cycleTimer_Stop());
+    _tsecWorker_CountEnd(worker, TSecStage_Encrypt, &counted);
+
+    _tsecWorker_CountBegin(worker, &counted);
+    start = cycleTimer_Start();
+    _deriveKeyFromName(&worker->keyContext, name, key);
+    success = success && streamCipher_InitOpen(&opener, header, key);
+    sodium_memzero(key, sizeof(key));
+    *decryptTime = cycleTimer_Nanos(start, cycleTimer_Stop());
+    _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+    size_t offset = 0;
+    while (success && offset < worker->streamObjectSize) {
+        size_t remaining = worker->streamObjectSize - offset;
+        size_t length = remaining < worker->streamChunkSize ? remaining : worker->streamChunkSize;
+        bool final = (length == remaining);
+        randombytes_buf(worker->streamPlaintext, length);
+
+        _tsecWorker_CountBegin(worker, &counted);
+        start = cycleTimer_Start();
+        success = streamCipher_SealChunk(&sealer, worker->streamCiphertext, worker->streamPlaintext, length, final);
+        uint64_t sealed = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Encrypt, &counted);
+
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t opening = cycleTimer_Start();
+        success = success && streamCipher_OpenChunk(&opener, worker->streamOutput, worker->streamCiphertext,
+                                                    length + STREAM_CHUNK_OVERHEAD);
+        uint64_t opened = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+        *encryptTime += cycleTimer_Nanos(start, sealed);
+        *decryptTime += cycleTimer_Nanos(opening, opened);
+
+        success = success && memcmp(worker->streamOutput, worker->streamPlaintext, length) == 0;
+        offset += length;
+    }
+
+    return success && streamCipher_IsFinished(&opener);
+}
+
+// One pass of the pipeline with every transient buffer on the heap
+static void
+_tsecWorker_HeapIteration(TSecWorker *worker, size_t nameIndex, TSecStatsEntry *entry)
+{
+    TSecReverseTable *table = worker->table;
+    PARCBuffer *nameBuffer = worker->names[nameIndex];
+    PerfSample counted;
+
+    // 1. Obfuscation
+    PARCBuffer *obfuscatedName = NULL;
+    uint64_t obfuscateTime = 0;
+    if (worker->batchNames != NULL) {
+        // Taken over from the batch and released with the other buffers below
+        obfuscatedName = worker->batchNames[nameIndex];
+        worker->batchNames[nameIndex] = NULL;
+        obfuscateTime = worker->batchTimes[nameIndex];
+    } else {
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startObfuscationTime = cycleTimer_Start();
+        obfuscatedName = _obfuscateName(worker->hasher, worker->trie, worker->scratch, nameBuffer);
+        uint64_t endObfuscationTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Obfuscate, &counted);
+        obfuscateTime = cycleTimer_Nanos(startObfuscationTime, endObfuscationTime);
+    }
+
+    // Save the mapping in the table (this is an offline step)
+    _reverseTable_Put(table, obfuscatedName, nameBuffer);
+
+    // 2. De-obfuscation
+    _tsecWorker_CountBegin(worker, &counted);
+    uint64_t startDeobfuscationTime = cycleTimer_Start();
+    PARCBuffer *originalNameBuffer = _reverseName(table, obfuscatedName);
+    uint64_t endDeobfuscationTime = cycleTimer_Stop();
+    _tsecWorker_CountEnd(worker, TSecStage_Deobfuscate, &counted);
+
+    assertNotNull(originalNameBuffer, "Expected the original name to be retrieved");
+
+    PARCBuffer *reverseName = NULL;
+    uint64_t encryptTime = 0;
+    uint64_t decryptTime = 0;
+    size_t payloadLength = worker->streamObjectSize;
+    if (worker->streamObjectSize > 0) {
+        // 3-4. Streamed encryption and decryption
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startDecryptionTime = cycleTimer_Start();
+        reverseName = _reverseName(table, obfuscatedName);
+        uint64_t endDecryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+        bool streamed = _streamContent(worker, nameBuffer, &encryptTime, &decryptTime);
+        decryptTime += cycleTimer_Nanos(startDecryptionTime, endDecryptionTime);
+
+        assertTrue(streamed, "Expected streamed decryption to succeed");
+    } else {
+        // 3. Encryption
+        size_t dataSize = randomDataSize();
+        payloadLength = dataSize;
+        PARCBuffer *dataBuffer = _createRandomBuffer(worker->rng, dataSize);
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startEncryptionTime = cycleTimer_Start();
+        PARCBuffer *payload = _encryptContent(&worker->keyContext, nameBuffer, dataBuffer);
+        uint64_t endEncryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Encrypt, &counted);
+
+        assertNotNull(payload, "Expected encryption to succeed");
+
+        // 4. Decryption
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startDecryptionTime = cycleTimer_Start();
+        reverseName = _reverseName(table, obfuscatedName);
+        bool decrypted = _decryptContent(&worker->keyContext, nameBuffer, payload, worker->plaintext);
+        uint64_t endDecryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+        assertTrue(decrypted && parcBuffer_Equals(worker->plaintext, dataBuffer), "Expected decryption to succeed");
+
+        encryptTime = cycleTimer_Nanos(startEncryptionTime, endEncryptionTime);
+        decryptTime = cycleTimer_Nanos(startDecryptionTime, endDecryptionTime);
+
+        parcBuffer_Release(&dataBuffer);
+        parcBuffer_Release(&payload);
+    }
+
+    assertTrue(parcBuffer_Equals(originalNameBuffer, reverseName), "Expected name retrieval to succeed");
+
+    parcBuffer_Release(&obfuscatedName);
+    parcBuffer_Release(&originalNameBuffer);
+    parcBuffer_Release(&reverseName);
+
+    entry->obfuscateTime = obfuscateTime;
+    entry->deobfuscateTime = cycleTimer_Nanos(startDeobfuscationTime, endDeobfuscationTime);
+    entry->encryptTime = encryptTime;
+    entry->decryptTime = decryptTime;
+    entry->payloadLength = payloadLength;
+}
+
+// The same pass with every transient byte array carved from the worker's arena
+// and table lookups done in place, so it makes no heap allocations or refcount
+// changes of its own. The arena is reset when the pass ends.
+static void
+_tsecWorker_ArenaIteration(TSecWorker *worker, size_t nameIndex, TSecStatsEntry *entry)
+{
+    TSecReverseTable *table = worker->table;
+    Arena *arena = worker->arena;
+    PARCBuffer *nameBuffer = worker->names[nameIndex];
+    const uint8_t *name = parcBuffer_Overlay(nameBuffer, 0);
+    size_t nameLength = parcBuffer_Remaining(nameBuffer);
+    PerfSample counted;
+
+    // 1. Obfuscation
+    const uint8_t *obfuscatedName = NULL;
+    size_t obfuscatedLength = 0;
+    uint64_t obfuscateTime = 0;
+    if (worker->batchNames != NULL) {
+        obfuscatedName = parcBuffer_Overlay(worker->batchNames[nameIndex], 0);
+        obfuscatedLength = parcBuffer_Remaining(worker->batchNames[nameIndex]);
+        obfuscateTime = worker->batchTimes[nameIndex];
+    } else {
+        uint8_t *output = arena_Allocate(arena, TSEC_OBFUSCATED_LENGTH_BOUND(nameLength));
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startObfuscationTime = cycleTimer_Start();
+        obfuscatedLength = _obfuscateNameInto(worker->hasher, worker->trie, worker->scratch, name, nameLength, output);
+        uint64_t endObfuscationTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Obfuscate, &counted);
+        obfuscatedName = output;
+        obfuscateTime = cycleTimer_Nanos(startObfuscationTime, endObfuscationTime);
+    }
+
+    // Save the mapping in the table (this is an offline step)
+    _reverseTable_PutArray(table, obfuscatedName, obfuscatedLength, name, nameLength);
+
+    // 2. De-obfuscation
+    size_t originalLength = 0;
+    _tsecWorker_CountBegin(worker, &counted);
+    uint64_t startDeobfuscationTime = cycleTimer_Start();
+    const uint8_t *originalName = _reverseTable_Lookup(table, obfuscatedName, obfuscatedLength, &originalLength);
+    uint64_t endDeobfuscationTime = cycleTimer_Stop();
+    _tsecWorker_CountEnd(worker, TSecStage_Deobfuscate, &counted);
+
+    assertNotNull(originalName, "Expected the original name to be retrieved");
+
+    const uint8_t *reverseName = NULL;
+    size_t reverseLength = 0;
+    uint64_t encryptTime = 0;
+    uint64_t decryptTime = 0;
+    size_t payloadLength = worker->streamObjectSize;
+    if (worker->streamObjectSize > 0) {
+        // 3-4. Streamed encryption and decryption
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startDecryptionTime = cycleTimer_Start();
+        reverseName = _reverseTable_Lookup(table, obfuscatedName, obfuscatedLength, &reverseLength);
+        uint64_t endDecryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+        bool streamed = _streamContent(worker, nameBuffer, &encryptTime, &decryptTime);
+        decryptTime += cycleTimer_Nanos(startDecryptionTime, endDecryptionTime);
+
+        assertTrue(streamed, "Expected streamed decryption to succeed");
+    } else {
+        // 3. Encryption
+        size_t dataSize = randomDataSize();
+        payloadLength = dataSize;
+        uint8_t *data = arena_Allocate(arena, dataSize);
+        uint8_t *payload = arena_Allocate(arena, dataSize + TSEC_PAYLOAD_OVERHEAD);
+        uint8_t *plaintext = arena_Allocate(arena, dataSize);
+        uint8_t key[TSEC_KEY_LENGTH];
+        randombytes_buf(data, dataSize);
+
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startEncryptionTime = cycleTimer_Start();
+        _deriveKey(&worker->keyContext, name, nameLength, key);
+        bool sealed = _sealPlaintext(payload, data, dataSize, key);
+        uint64_t endEncryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Encrypt, &counted);
+
+        assertTrue(sealed, "Expected encryption to succeed");
+
+        // 4. Decryption
+        _tsecWorker_CountBegin(worker, &counted);
+        uint64_t startDecryptionTime = cycleTimer_Start();
+        reverseName = _reverseTable_Lookup(table, obfuscatedName, obfuscatedLength, &reverseLength);
+        _deriveKey(&worker->keyContext, name, nameLength, key);
+        bool decrypted = _openCiphertext(plaintext, payload, dataSize + TSEC_PAYLOAD_OVERHEAD, key);
+        uint64_t endDecryptionTime = cycleTimer_Stop();
+        _tsecWorker_CountEnd(worker, TSecStage_Decrypt, &counted);
+
+        sodium_memzero(key, sizeof(key));
+        assertTrue(decrypted && memcmp(plaintext, data, dataSize) == 0, "Expected decryption to succeed");
+
+        encryptTime = cycleTimer_Nanos(startEncryptionTime, endEncryptionTime);
+        decryptTime = cycleTimer_Nanos(startDecryptionTime, endDecryptionTime);
+    }
+
+    assertTrue(reverseLength == originalLength && memcmp(originalName, reverseName, originalLength) == 0,
+               "Expected name retrieval to succeed");
+
+    if (worker->batchNames != NULL) {
+        parcBuffer_Release(&worker->batchNames[nameIndex]);
+    }
+    arena_Reset(arena);
+
+    entry->obfuscateTime = obfuscateTime;
+    entry->deobfuscateTime = cycleTimer_Nanos(startDeobfuscationTime, endDeobfuscationTime);
+    entry->encryptTime = encryptTime;
+    entry->decryptTime = decryptTime;
+    entry->payloadLength = payloadLength;
+}
+
+// Throughput mode: cycle through the worker's names back to back, or paced at
+// its offered load, until the quota or the deadline is reached. Stage times are
+// summed rather than kept per name, so a long run needs no extra memory.
+static void
+_tsecWorker_RunSustained(TSecWorker *worker)
+{
+    size_t rangeLength = worker->end - worker->start;
+    if (rangeLength == 0) {
+        return;
+    }
+
+    Throughput *throughput = &worker->throughput;
+    ThroughputPacer pacer;
+    throughputPacer_Start(&pacer, worker->offeredLoad);
+    uint64_t startCpuTime = throughput_ThreadCpuNanos();
+
+    uint64_t count;
+    for (count = 0; count < worker->quota && !*worker->stopped; count++) {
+        if (worker->deadline != UINT64_MAX && throughput_MonotonicNanos() >= worker->deadline) {
+            break;
+        }
+        if (!throughputPacer_Wait(&pacer)) {
+            throughput->late++;
+        }
+
+        TSecStatsEntry entry;
+        size_t nameIndex = worker->start + count % rangeLength;
+        if (worker->arena != NULL) {
+            _tsecWorker_ArenaIteration(worker, nameIndex, &entry);
+        } else {
+            _tsecWorker_HeapIteration(worker, nameIndex, &entry);
+        }
+
+        throughput->names++;
+        throughput->nameBytes += parcBuffer_Remaining(worker->names[nameIndex]);
+        throughput->payloadBytes += entry.payloadLength;
+        throughput->obfuscateTime += entry.obfuscateTime;
+        throughput->deobfuscateTime += entry.deobfuscateTime;
+        throughput->encryptTime += entry.encryptTime;
+        throughput->decryptTime += entry.decryptTime;
+        _tsecStats_Record(worker->latency, &entry);
+    }
+
+    throughput->cpuTime = throughput_ThreadCpuNanos() - startCpuTime;
+}
+
+static void *
+_tsecWorker_Run(void *arg)
+{
+    TSecWorker *worker = (TSecWorker *) arg;
+
+    // Counters follow the thread that opens them, so each worker opens its own
+    worker->counting = perfCounters_Enabled() && perfCounters_Open(&worker->counters);
+
+    if (worker->sustained) {
+        _tsecWorker_RunSustained(worker);
+    } else {
+        size_t nameIndex;
+        for (nameIndex = worker->start; nameIndex < worker->end && !*worker->stopped; nameIndex++) {
+            TSecStatsEntry entry;
+            if (worker->arena != NULL) {
+                _tsecWorker_ArenaIteration(worker, nameIndex, &entry);
+            } else {
+                _tsecWorker_HeapIteration(worker, nameIndex, &entry);
+            }
+
+            _tsecStats_Record(worker->latency, &entry);
+        }
+    }
+
+    if (worker->counting) {
+        perfCounters_Close(&worker->counters);
+    }
+    return NULL;
+}
+
+
+// One pipeline benchmark: the settings taken from the options and arguments
+// (uri_file n alg [params]), then what pipeline_Run measured
+typedef struct {
+    const BenchOptions *options;
+    const char *uriPath;
+    int N;
+    HashType hashAlgorithm;
+    const char *cipherName;
+    bool sustained;             // throughput mode (-d or -r)
+
+    size_t numNames;
+    uint64_t wallTime;
+    Histogram *latency;         // TSecStage_Count histograms
+    PerfSample counts[TSecStage_Count];
+    Throughput throughput;
+    uint64_t keyHits;
+    uint64_t keyLookups;
+    uint64_t prefixHits;
+    uint64_t prefixLookups;
+} Pipeline;
+
+double
+pipeline_KeyCacheHitRate(const Pipeline *pipeline)
+{
+    return pipeline->keyLookups == 0 ? 0.0 : ((double) pipeline->keyHits) / pipeline->keyLookups;
+}
+
+double
+pipeline_PrefixHitRate(const Pipeline *pipeline)
+{
+    return pipeline->prefixLookups == 0 ? 0.0 : ((double) pipeline->prefixHits) / pipeline->prefixLookups;
+}
+
+/**
+ * Check the options and arguments and configure the hash, cipher and pools for
+ * them. Returns false, having said why on stderr where there is more to say
+ * than the usage, if they cannot be run.
+ */
+bool
+pipeline_Setup(Pipeline *pipeline, const BenchOptions *options)
+{
+    memset(pipeline, 0, sizeof(Pipeline));
+    pipeline->options = options;
+    if (options->argc < 3) {
+        return false;
+    }
+
+    if (options->cipherName != NULL) {
+        contentCipher = aead_Select(options->cipherName);
+        if (contentCipher == NULL) {
+            fprintf(stderr, "Cipher %s is unknown or not supported by this CPU\n", options->cipherName);
+            return false;
+        }
+    }
+    pipeline->cipherName = options->streamObjectSize > 0 ? "secretstream-xchacha20poly1305" : contentCipher->name;
+
+    pipeline->uriPath = options->argv[0];
+    pipeline->N = atoi(options->argv[1]);
+    if (pipeline->N > TSEC_MAX_OBFUSCATED_SEGMENTS) {
+        fprintf(stderr, "Names of more than %d segments do not fit in an obfuscated name\n", TSEC_MAX_OBFUSCATED_SEGMENTS);
+        return false;
+    }
+
+    int hashAlgorithm = benchOptions_ParseHash(options->argc - 2, options->argv + 2);
+    if (hashAlgorithm < 0) {
+        return false;
+    }
+    pipeline->hashAlgorithm = (HashType) hashAlgorithm;
+    chainedPrefixHashing = hashAlgorithm == HashType_SHA256;
+
+    if (!benchOptions_Apply(options)) {
+        return false;
+    }
+    if (options->blockPoolMode != NULL && hashAlgorithm == HashType_Argon2) {
+        // One region per worker, since that is how many hashes run at once
+        blockPool_Reserve(argon2MCost, options->numThreads);
+    }
+
+    if ((options->buildTablePath != NULL || options->tablePath != NULL) && hashAlgorithm != HashType_SHA256 &&
+        !keyedSalt_Enabled()) {
+        fprintf(stderr, "Memory-hard hashes draw a random salt per hash unless -n is given, so their names cannot be prebuilt\n");
+        return false;
+    }
+
+    if (options->memoizePrefixes && hashAlgorithm != HashType_SHA256 && !keyedSalt_Enabled()) {
+        fprintf(stderr, "Memory-hard digests are only reproducible, and so only memoizable, with -n\n");
+        return false;
+    }
+
+    if (options->batchSize > 0 && hashAlgorithm != HashType_SHA256) {
+        fprintf(stderr, "Batch obfuscation is only available for SHA256\n");
+        return false;
+    }
+
+    pipeline->sustained = options->duration > 0 || options->nameCount > 0;
+    if (options->offeredLoad > 0 && !pipeline->sustained) {
+        fprintf(stderr, "An offered load needs a throughput run (-d or -r)\n");
+        return false;
+    }
+    if (pipeline->sustained && options->batchSize > 0) {
+        fprintf(stderr, "Throughput mode obfuscates names as it goes and cannot use -b\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The offline step (-o): write the reverse table for the URI file and stop.
+ */
+int
+pipeline_BuildTable(Pipeline *pipeline)
+{
+    URILoader *loader = uriLoader_Open(pipeline->uriPath);
+    if (loader == NULL) {
+        perror("Could not open file");
+        return -1;
+    }
+    int result = _buildTableFile(pipeline->hashAlgorithm, pipeline->N, loader, pipeline->options->buildTablePath,
+                                 pipeline->options->memoizePrefixes);
+    uriLoader_Close(&loader);
+    return result;
+}
+
+/**
+ * Run the names in the URI file through the pipeline on the configured
+ * workers. Per-stage latencies, counters and throughput are left in pipeline,
+ * and secondary statistics are written to stderr.
+ */
+bool
+pipeline_Run(Pipeline *pipeline)
+{
+    const BenchOptions *options = pipeline->options;
+    int numThreads = options->numThreads;
+    int N = pipeline->N;
+
+    NameTable *prebuilt = NULL;
+    if (options->tablePath != NULL) {
+        uint64_t parameters = 0;
+        prebuilt = nameTable_Load(options->tablePath, &parameters);
+        if (prebuilt == NULL) {
+            fprintf(stderr, "Could not map table file %s\n", options->tablePath);
+            return false;
+        }
+        if (parameters != _tableParameters(pipeline->hashAlgorithm, N)) {
+            fprintf(stderr, "Table file %s was built with different obfuscation parameters\n", options->tablePath);
+            nameTable_Release(&prebuilt);
+            return false;
+        }
+    }
+
+    URILoader *loader = uriLoader_Open(pipeline->uriPath);
+    if (loader == NULL) {
+        perror("Could not open file");
+        if (prebuilt != NULL) {
+            nameTable_Release(&prebuilt);
+        }
+        return false;
+    }
+
+    // Create the list to hold all of the names; it owns them until the run ends
+    PARCLinkedList *nameList = parcLinkedList_Create();
+
+    TSecNameScratch *scratch = parcMemory_Allocate(sizeof(TSecNameScratch));
+    const uint8_t *uri = NULL;
+    size_t uriLength = 0;
+    while (uriLoader_Next(loader, &uri, &uriLength)) {
+        PARCBuffer *encodedBuffer = NULL;
+        if (!_encodeURI(NULL, NULL, scratch, uri, uriLength, N, &encodedBuffer, NULL)) {
+            encodedBuffer = _encodeURIWithName(uri, uriLength, N);
+            if (encodedBuffer == NULL) {
+                continue;
+            }
+        }
+        parcLinkedList_Append(nameList, encodedBuffer);
+        parcBuffer_Release(&encodedBuffer);
+    }
+    uriLoader_Close(&loader);
+    parcMemory_Deallocate(&scratch);
+
+    size_t numNames = parcLinkedList_Size(nameList);
+    TSecReverseTable *table = _reverseTable_Create(numNames);
+    table->prebuilt = prebuilt;
+    PARCBuffer **encodedNames = parcMemory_Allocate(numNames * sizeof(PARCBuffer *) + 1);
+    size_t i = 0;
+    PARCIterator *iterator = parcLinkedList_CreateIterator(nameList);
+    while (parcIterator_HasNext(iterator)) {
+        encodedNames[i++] = parcIterator_Next(iterator);
+    }
+    parcIterator_Release(&iterator);
+
+    // In batch mode, obfuscate the whole list up front and charge each name an
+    // equal share of its batch's time
+    PARCBuffer **batchNames = NULL;
+    uint64_t *batchTimes = NULL;
+    PerfSample batchCounts;
+    memset(&batchCounts, 0, sizeof(batchCounts));
+    if (options->batchSize > 0) {
+        batchNames = parcMemory_Allocate(numNames * sizeof(PARCBuffer *) + 1);
+        batchTimes = parcMemory_Allocate(numNames * sizeof(uint64_t) + 1);
+        PerfCounters counters;
+        bool counting = perfCounters_Enabled() && perfCounters_Open(&counters);
+
+        for (i = 0; i < numNames; i += options->batchSize) {
+            size_t count = numNames - i < (size_t) options->batchSize ? numNames - i : (size_t) options->batchSize;
+            PerfSample before;
+            PerfSample after;
+            if (counting) {
+                perfCounters_Read(&counters, &before);
+            }
+            uint64_t startBatchTime = cycleTimer_Start();
+            _obfuscateNameBatch(&encodedNames[i], count, &batchNames[i]);
+            uint64_t endBatchTime = cycleTimer_Stop();
+            if (counting) {
+                perfCounters_Read(&counters, &after);
+                perfSample_AddDelta(&batchCounts, &before, &after);
+            }
+
+            size_t j;
+            for (j = i; j < i + count; j++) {
+                batchTimes[j] = cycleTimer_Nanos(startBatchTime, endBatchTime) / count;
+            }
+        }
+        if (counting) {
+            perfCounters_Close(&counters);
+        }
+
+        fprintf(stderr, "SHA256 kernel: %s\n", sha256MultiBuffer_KernelName(sha256MultiBuffer_SelectKernel()));
+    }
+
+    // Split the names into contiguous ranges, one per worker
+    volatile bool stopped = false;
+    TSecWorker *workers = parcMemory_AllocateAndClear(numThreads * sizeof(TSecWorker));
+    pthread_t *threads = parcMemory_AllocateAndClear(numThreads * sizeof(pthread_t));
+    int t;
+    for (t = 0; t < numThreads; t++) {
+        workers[t].names = encodedNames;
+        workers[t].batchNames = batchNames;
+        workers[t].batchTimes = batchTimes;
+        workers[t].start = numNames * t / numThreads;
+        workers[t].end = numNames * (t + 1) / numThreads;
+        workers[t].N = N;
+        workers[t].table = table;
+        workers[t].hasher = digestHasher_Create(pipeline->hashAlgorithm);
+        workers[t].rng = parcSecureRandom_Create();
+        workers[t].plaintext = parcBuffer_Allocate(maxDataSize());
+        workers[t].keyContext.hasher = digestHasher_Create(HashType_SHA256);
+        workers[t].keyContext.cache = options->keyCacheSize > 0 ? keyCache_Create(options->keyCacheSize) : NULL;
+        workers[t].streamObjectSize = options->streamObjectSize;
+        workers[t].streamChunkSize = options->streamChunkSize;
+        if (options->streamObjectSize > 0) {
+            workers[t].streamPlaintext = parcMemory_Allocate(options->streamChunkSize);
+            workers[t].streamCiphertext = parcMemory_Allocate(options->streamChunkSize + STREAM_CHUNK_OVERHEAD);
+            workers[t].streamOutput = parcMemory_Allocate(options->streamChunkSize);
+        }
+        // Sized for the largest single-shot payload: data, sealed copy and plaintext
+        workers[t].arena = options->useArena ? arena_Create(3 * maxDataSize() + 4096) : NULL;
+        workers[t].trie = options->memoizePrefixes ? prefixTrie_Create(workers[t].end - workers[t].start) : NULL;
+        workers[t].scratch = parcMemory_Allocate(sizeof(TSecNameScratch));
+        workers[t].stopped = &stopped;
+
+        workers[t].sustained = pipeline->sustained;
+        workers[t].quota = options->nameCount > 0 ?
+                           options->nameCount * (t + 1) / numThreads - options->nameCount * t / numThreads : UINT64_MAX;
+        workers[t].offeredLoad = options->offeredLoad / numThreads;
+    }
+
+    uint64_t deadline = options->duration > 0 ?
+                        throughput_MonotonicNanos() + (uint64_t) (options->duration * 1e9) : UINT64_MAX;
+    for (t = 0; t < numThreads; t++) {
+        workers[t].deadline = deadline;
+    }
+
+    PARCStopwatch *wallTimer = parcStopwatch_Create();
+    parcStopwatch_Start(wallTimer);
+    // If a thread cannot be started, the ones already running are stopped and
+    // joined, and the run fails
+    bool started = true;
+    if (numThreads == 1) {
+        _tsecWorker_Run(&workers[0]);
+    } else {
+        int numStarted;
+        for (numStarted = 0; numStarted < numThreads; numStarted++) {
+            int error = pthread_create(&threads[numStarted], NULL, _tsecWorker_Run, &workers[numStarted]);
+            if (error != 0) {
+                fprintf(stderr, "Could not start worker thread %d: %s\n", numStarted, strerror(error));
+                stopped = true;
+                started = false;
+                break;
+            }
+        }
+        for (t = 0; t < numStarted; t++) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+    uint64_t wallTime = parcStopwatch_ElapsedTimeNanos(wallTimer);
+    parcStopwatch_Release(&wallTimer);
+
+    uint64_t arenaOverflows = 0;
+    size_t arenaHighWater = 0;
+    pipeline->numNames = numNames;
+    pipeline->wallTime = wallTime;
+    pipeline->latency = parcMemory_AllocateAndClear(TSecStage_Count * sizeof(Histogram));
+    // Batch obfuscation ran up front on this thread
+    perfSample_Add(&pipeline->counts[TSecStage_Obfuscate], &batchCounts);
+    for (t = 0; t < numThreads; t++) {
+        throughput_Add(&pipeline->throughput, &workers[t].throughput);
+        int stage;
+        for (stage = 0; stage < TSecStage_Count; stage++) {
+            histogram_Add(&pipeline->latency[stage], &workers[t].latency[stage]);
+            perfSample_Add(&pipeline->counts[stage], &workers[t].counts[stage]);
+        }
+
+        parcSecureRandom_Release(&workers[t].rng);
+        parcBuffer_Release(&workers[t].plaintext);
+        digestHasher_Release(&workers[t].keyContext.hasher);
+        if (workers[t].streamObjectSize > 0) {
+            parcMemory_Deallocate(&workers[t].streamPlaintext);
+            parcMemory_Deallocate(&workers[t].streamCiphertext);
+            parcMemory_Deallocate(&workers[t].streamOutput);
+        }
+        if (workers[t].keyContext.cache != NULL) {
+            pipeline->keyHits += workers[t].keyContext.cache->hits;
+            pipeline->keyLookups += workers[t].keyContext.cache->hits + workers[t].keyContext.cache->misses;
+            keyCache_Release(&workers[t].keyContext.cache);
+        }
+        if (workers[t].trie != NULL) {
+            pipeline->prefixHits += workers[t].trie->hits;
+            pipeline->prefixLookups += workers[t].trie->hits + workers[t].trie->misses;
+            prefixTrie_Release(&workers[t].trie);
+        }
+        if (workers[t].arena != NULL) {
+            size_t highWater = arena_HighWater(workers[t].arena);
+            arenaHighWater = highWater > arenaHighWater ? highWater : arenaHighWater;
+            arenaOverflows += workers[t].arena->overflows;
+            arena_Release(&workers[t].arena);
+        }
+        parcMemory_Deallocate(&workers[t].scratch);
+        digestHasher_Release(&workers[t].hasher);
+    }
+
+    if (started) {
+        if (options->histogramPath != NULL && !dumpHistograms(pipeline->latency, options->histogramPath)) {
+            perror("Could not write histograms");
+        }
+
+        perfCounters_ReportMissing();
+        if (pipeline->keyLookups > 0) {
+            fprintf(stderr, "key cache hit rate: %f\n", pipeline_KeyCacheHitRate(pipeline));
+        }
+        if (options->useArena) {
+            fprintf(stderr, "arena high water: %zu bytes, %llu overflows\n", arenaHighWater, (unsigned long long) arenaOverflows);
+        }
+        if (blockPool_Enabled()) {
+            fprintf(stderr, "block pool: %llu regions mapped, %llu reused\n",
+                    (unsigned long long) blockPool.mapped, (unsigned long long) blockPool.reused);
+        }
+        if (numThreads > 1) {
+            fprintf(stderr, "threads=%d,names=%zu,wall_ns=%llu,contended=%llu\n", numThreads, numNames,
+                    (unsigned long long) wallTime, (unsigned long long) table->contended);
+        }
+    }
+
+    if (batchNames != NULL) {
+        // Workers release the batch names they reach; a stopped run leaves the rest
+        for (i = 0; i < numNames; i++) {
+            if (batchNames[i] != NULL) {
+                parcBuffer_Release(&batchNames[i]);
+            }
+        }
+        parcMemory_Deallocate(&batchNames);
+        parcMemory_Deallocate(&batchTimes);
+    }
+    parcMemory_Deallocate(&threads);
+    parcMemory_Deallocate(&workers);
+    parcMemory_Deallocate(&encodedNames);
+    parcLinkedList_Release(&nameList);
+
+    _reverseTable_Release(&table);
+    if (!started) {
+        parcMemory_Deallocate(&pipeline->latency);
+    }
+    return started;
+}
+
+void
+pipeline_Release(Pipeline *pipeline)
+{
+    if (pipeline->latency != NULL) {
+        parcMemory_Deallocate(&pipeline->latency);
+    }
+}
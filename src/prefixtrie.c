@@ -0,0 +1,208 @@
+#include <parc/algol/parc_Object.h>
+#include <parc/algol/parc_Memory.h>
+
+#include <sodium.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Trie of name prefixes that remembers the obfuscated digest of every prefix
+// it has seen, so a prefix shared by many names is hashed once.
+//
+// Nodes live in one array and are addressed by index; node 0 is the empty root.
+// Children are not stored per node: an edge (parent, segment type, segment
+// value) is hashed with SipHash into a single open-addressing index, so finding
+// a child is one probe sequence and the trie costs one slot per node. Segment
+// values are copied into a byte pool and referenced by offset. A trie is not
+// synchronized; give each thread its own.
+
+#define PREFIX_TRIE_DIGEST_LENGTH 32
+#define PREFIX_TRIE_ROOT 0
+
+typedef struct {
+    uint64_t hash;
+    uint64_t valueOffset;
+    uint32_t parent;
+    uint32_t valueLength;
+    uint16_t type;
+    uint8_t digest[PREFIX_TRIE_DIGEST_LENGTH];
+} PrefixTrieNode;
+
+typedef struct {
+    PrefixTrieNode *nodes;
+    size_t numNodes;
+    size_t maxNodes;
+
+    uint32_t *index;        // node numbers; 0 (the root, never a child) marks an empty slot
+    size_t indexCapacity;   // always a power of two
+
+    uint8_t *values;
+    size_t valuesLength;
+    size_t valuesCapacity;
+
+    uint8_t hashKey[crypto_shorthash_KEYBYTES];
+
+    uint64_t hits;
+    uint64_t misses;
+} PrefixTrie;
+
+static bool
+_prefixTrie_Destructor(PrefixTrie **triePtr)
+{
+    PrefixTrie *trie = *triePtr;
+    parcMemory_Deallocate(&trie->nodes);
+    parcMemory_Deallocate(&trie->index);
+    parcMemory_Deallocate(&trie->values);
+    return true;
+}
+
+parcObject_Override(PrefixTrie, PARCObject,
+                    .destructor = (PARCObjectDestructor *) _prefixTrie_Destructor);
+
+parcObject_ImplementAcquire(prefixTrie, PrefixTrie);
+parcObject_ImplementRelease(prefixTrie, PrefixTrie);
+
+/**
+ * Create an empty trie sized for about expectedNodes prefixes; it grows as needed.
+ */
+PrefixTrie *
+prefixTrie_Create(size_t expectedNodes)
+{
+    PrefixTrie *trie = parcObject_CreateInstance(PrefixTrie);
+    if (trie != NULL) {
+        trie->maxNodes = expectedNodes < 16 ? 16 : expectedNodes;
+        trie->nodes = parcMemory_AllocateAndClear(trie->maxNodes * sizeof(PrefixTrieNode));
+        trie->numNodes = 1;
+
+        trie->indexCapacity = 32;
+        while (trie->indexCapacity < trie->maxNodes * 2) {
+            trie->indexCapacity <<= 1;
+        }
+        trie->index = parcMemory_AllocateAndClear(trie->indexCapacity * sizeof(uint32_t));
+
+        trie->valuesCapacity = trie->maxNodes * 16;
+        trie->values = parcMemory_Allocate(trie->valuesCapacity);
+        trie->valuesLength = 0;
+
+        randombytes_buf(trie->hashKey, sizeof(trie->hashKey));
+        trie->hits = 0;
+        trie->misses = 0;
+    }
+    return trie;
+}
+
+static uint64_t
+_prefixTrie_Hash(const PrefixTrie *trie, uint32_t parent, uint16_t type, const uint8_t *value, size_t length)
+{
+    uint64_t hash;
+    crypto_shorthash((unsigned char *) &hash, value, length, trie->hashKey);
+    return hash ^ (((uint64_t) parent << 16 | type) * 0x9E3779B97F4A7C15ULL);
+}
+
+static uint32_t *
+_prefixTrie_Find(PrefixTrie *trie, uint64_t hash, uint32_t parent, uint16_t type, const uint8_t *value, size_t length)
+{
+    size_t slot = (size_t) hash & (trie->indexCapacity - 1);
+    while (trie->index[slot] != PREFIX_TRIE_ROOT) {
+        PrefixTrieNode *node = &trie->nodes[trie->index[slot]];
+        if (node->hash == hash && node->parent == parent && node->type == type && node->valueLength == length &&
+            memcmp(trie->values + node->valueOffset, value, length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (trie->indexCapacity - 1);
+    }
+    return &trie->index[slot];
+}
+
+static void
+_prefixTrie_Grow(PrefixTrie *trie)
+{
+    size_t maxNodes = trie->maxNodes * 2;
+    PrefixTrieNode *nodes = parcMemory_Allocate(maxNodes * sizeof(PrefixTrieNode));
+    memcpy(nodes, trie->nodes, trie->numNodes * sizeof(PrefixTrieNode));
+    parcMemory_Deallocate(&trie->nodes);
+    trie->nodes = nodes;
+    trie->maxNodes = maxNodes;
+
+    // Keep the index at or below half full
+    parcMemory_Deallocate(&trie->index);
+    trie->indexCapacity <<= 1;
+    trie->index = parcMemory_AllocateAndClear(trie->indexCapacity * sizeof(uint32_t));
+    uint32_t n;
+    for (n = 1; n < trie->numNodes; n++) {
+        size_t slot = (size_t) trie->nodes[n].hash & (trie->indexCapacity - 1);
+        while (trie->index[slot] != PREFIX_TRIE_ROOT) {
+            slot = (slot + 1) & (trie->indexCapacity - 1);
+        }
+        trie->index[slot] = n;
+    }
+}
+
+/**
+ * Find the child of parent reached by the segment (type, value), adding it if
+ * it is new. *found reports whether it already existed, i.e. whether its
+ * digest (see prefixTrie_Digest) is valid or still has to be filled in.
+ */
+uint32_t
+prefixTrie_Child(PrefixTrie *trie, uint32_t parent, uint16_t type, const uint8_t *value, size_t length, bool *found)
+{
+    uint64_t hash = _prefixTrie_Hash(trie, parent, type, value, length);
+    uint32_t *slot = _prefixTrie_Find(trie, hash, parent, type, value, length);
+    if (*slot != PREFIX_TRIE_ROOT) {
+        trie->hits++;
+        *found = true;
+        return *slot;
+    }
+
+    trie->misses++;
+    *found = false;
+
+    if (trie->numNodes == trie->maxNodes) {
+        _prefixTrie_Grow(trie);
+        slot = _prefixTrie_Find(trie, hash, parent, type, value, length);
+    }
+    if (trie->valuesLength + length > trie->valuesCapacity) {
+        size_t capacity = trie->valuesCapacity * 2 + length;
+        uint8_t *values = parcMemory_Allocate(capacity);
+        memcpy(values, trie->values, trie->valuesLength);
+        parcMemory_Deallocate(&trie->values);
+        trie->values = values;
+        trie->valuesCapacity = capacity;
+    }
+
+    uint32_t child = (uint32_t) trie->numNodes++;
+    PrefixTrieNode *node = &trie->nodes[child];
+    node->hash = hash;
+    node->parent = parent;
+    node->type = type;
+    node->valueLength = (uint32_t) length;
+    node->valueOffset = trie->valuesLength;
+    memcpy(trie->values + trie->valuesLength, value, length);
+    trie->valuesLength += length;
+
+    *slot = child;
+    return child;
+}
+
+/**
+ * The PREFIX_TRIE_DIGEST_LENGTH byte digest stored for node. The pointer is
+ * valid until the next prefixTrie_Child call.
+ */
+uint8_t *
+prefixTrie_Digest(PrefixTrie *trie, uint32_t node)
+{
+    return trie->nodes[node].digest;
+}
+
+size_t
+prefixTrie_Size(const PrefixTrie *trie)
+{
+    return trie->numNodes - 1;
+}
+
+double
+prefixTrie_HitRate(const PrefixTrie *trie)
+{
+    uint64_t lookups = trie->hits + trie->misses;
+    return lookups == 0 ? 0.0 : ((double) trie->hits) / lookups;
+}
@@ -0,0 +1,307 @@
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+// Self-describing benchmark results.
+//
+// A record is a flat list of named fields, written either as one JSON object
+// per line or as CSV with a header row taken from the first record. Callers add
+// the same fields in the same order to every record of a benchmark, null when a
+// value does not apply, so rows of one benchmark share a header. Appending a row
+// to a CSV file whose header differs is refused rather than misaligned. Every
+// record opens with the same metadata: schema version, benchmark, time, host
+// name and CPU, kernel, build configuration, timer, and library versions. The
+// caller then adds the algorithm parameters and its measurements, so a line of
+// output can be compared across hosts and builds on its own. Values are
+// formatted as they are added; nothing is allocated. A measurement that is not
+// available is written as null in JSON and as an empty field in CSV.
+
+#define RESULTS_SCHEMA_VERSION 1
+#define RESULTS_MAX_FIELDS 256
+#define RESULTS_KEY_LENGTH 48
+#define RESULTS_VALUE_LENGTH 256
+#define RESULTS_HEADER_LENGTH (RESULTS_MAX_FIELDS * RESULTS_KEY_LENGTH)
+
+typedef enum {
+    ResultFormat_JSON,
+    ResultFormat_CSV
+} ResultFormat;
+
+static struct {
+    FILE *file;
+    ResultFormat format;
+    char header[RESULTS_HEADER_LENGTH];     // CSV header already in the file; empty if none yet
+
+    size_t numFields;
+    char keys[RESULTS_MAX_FIELDS][RESULTS_KEY_LENGTH];
+    char values[RESULTS_MAX_FIELDS][RESULTS_VALUE_LENGTH];
+    bool quoted[RESULTS_MAX_FIELDS];        // a string rather than a number
+
+    // Host metadata, read once
+    char host[RESULTS_VALUE_LENGTH];
+    char cpu[RESULTS_VALUE_LENGTH];
+    char kernel[RESULTS_VALUE_LENGTH];
+    long cpus;
+} results;
+
+// The "model name" line of /proc/cpuinfo, or the machine type if there is none
+static void
+_results_ReadCPU(const char *machine)
+{
+    snprintf(results.cpu, sizeof(results.cpu), "%s", machine);
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo == NULL) {
+        return;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+        if (strncmp(line, "model name", 10) == 0) {
+            char *value = strchr(line, ':');
+            if (value != NULL) {
+                value += strspn(value + 1, " \t") + 1;
+                value[strcspn(value, "\n")] = '\0';
+                snprintf(results.cpu, sizeof(results.cpu), "%s", value);
+            }
+            break;
+        }
+    }
+    fclose(cpuinfo);
+}
+
+/**
+ * Write results in format ("json" or "csv") to path, or to stdout if path is
+ * NULL. Returns false if the format is unknown or the file cannot be opened.
+ */
+bool
+results_Open(const char *format, const char *path)
+{
+    if (strcasecmp(format, "json") == 0 || strcasecmp(format, "jsonl") == 0) {
+        results.format = ResultFormat_JSON;
+    } else if (strcasecmp(format, "csv") == 0) {
+        results.format = ResultFormat_CSV;
+    } else {
+        fprintf(stderr, "Result format %s is unknown\n", format);
+        return false;
+    }
+
+    results.file = path == NULL ? stdout : fopen(path, "a+");
+    if (results.file == NULL) {
+        perror("Could not open the results file");
+        return false;
+    }
+
+    // Appending to a CSV file that already has rows must not repeat the header,
+    // and new rows are checked against it
+    results.header[0] = '\0';
+    if (results.format == ResultFormat_CSV && path != NULL) {
+        rewind(results.file);
+        if (fgets(results.header, sizeof(results.header), results.file) != NULL) {
+            results.header[strcspn(results.header, "\r\n")] = '\0';
+        }
+        fseek(results.file, 0, SEEK_END);
+    }
+
+    struct utsname name;
+    if (uname(&name) == 0) {
+        snprintf(results.host, sizeof(results.host), "%s", name.nodename);
+        snprintf(results.kernel, sizeof(results.kernel), "%s %s %s", name.sysname, name.release, name.machine);
+        _results_ReadCPU(name.machine);
+    }
+    results.cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return true;
+}
+
+void
+results_Close(void)
+{
+    if (results.file != NULL && results.file != stdout) {
+        fclose(results.file);
+    }
+    results.file = NULL;
+}
+
+static void
+_results_Add(const char *key, bool quoted, const char *format, ...)
+{
+    if (results.numFields == RESULTS_MAX_FIELDS) {
+        return;
+    }
+    size_t i = results.numFields++;
+    snprintf(results.keys[i], RESULTS_KEY_LENGTH, "%s", key);
+    results.quoted[i] = quoted;
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(results.values[i], RESULTS_VALUE_LENGTH, format, arguments);
+    va_end(arguments);
+}
+
+void
+results_String(const char *key, const char *value)
+{
+    _results_Add(key, true, "%s", value);
+}
+
+void
+results_Unsigned(const char *key, uint64_t value)
+{
+    _results_Add(key, false, "%llu", (unsigned long long) value);
+}
+
+/**
+ * A field that does not apply to this record: null, or an empty CSV field.
+ */
+void
+results_Null(const char *key)
+{
+    _results_Add(key, false, "%s", results.format == ResultFormat_JSON ? "null" : "");
+}
+
+/**
+ * A number, or null if value is not finite.
+ */
+void
+results_Double(const char *key, double value)
+{
+    if (isfinite(value)) {
+        _results_Add(key, false, "%f", value);
+    } else {
+        results_Null(key);
+    }
+}
+
+/**
+ * Add a field named prefix_key, as in "obfuscate_p99".
+ */
+void
+results_PrefixedUnsigned(const char *prefix, const char *key, uint64_t value)
+{
+    char name[RESULTS_KEY_LENGTH];
+    snprintf(name, sizeof(name), "%s_%s", prefix, key);
+    results_Unsigned(name, value);
+}
+
+void
+results_PrefixedDouble(const char *prefix, const char *key, double value)
+{
+    char name[RESULTS_KEY_LENGTH];
+    snprintf(name, sizeof(name), "%s_%s", prefix, key);
+    results_Double(name, value);
+}
+
+/**
+ * Start a record for benchmark with the shared metadata fields.
+ */
+void
+results_Begin(const char *benchmark)
+{
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    results.numFields = 0;
+    results_Unsigned("schema", RESULTS_SCHEMA_VERSION);
+    results_String("benchmark", benchmark);
+    results_String("time", timestamp);
+    results_String("host", results.host);
+    results_String("cpu", results.cpu);
+    results_Unsigned("cpus", (uint64_t) results.cpus);
+    results_String("kernel", results.kernel);
+    results_String("build", buildInfo_Configuration());
+    results_String("timer", cycleTimer_Source());
+    results_Double("timer_hz", cycleTimer_Frequency());
+    results_String("libsodium", sodium_version_string());
+    results_Unsigned("argon2_version", ARGON2_VERSION_NUMBER);
+}
+
+static void
+_results_WriteJSONString(const char *value)
+{
+    fputc('"', results.file);
+    for (; *value != '\0'; value++) {
+        unsigned char c = (unsigned char) *value;
+        if (c == '"' || c == '\\') {
+            fprintf(results.file, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(results.file, "\\u%04x", c);
+        } else {
+            fputc(c, results.file);
+        }
+    }
+    fputc('"', results.file);
+}
+
+// RFC 4180: quote fields with separators, quotes or line breaks, doubling quotes
+static void
+_results_WriteCSVField(const char *value)
+{
+    if (strpbrk(value, ",\"\r\n") == NULL) {
+        fputs(value, results.file);
+        return;
+    }
+    fputc('"', results.file);
+    for (; *value != '\0'; value++) {
+        if (*value == '"') {
+            fputc('"', results.file);
+        }
+        fputc(*value, results.file);
+    }
+    fputc('"', results.file);
+}
+
+/**
+ * Write the record started by results_Begin. Returns false, writing nothing,
+ * if the record's CSV columns differ from the header already in the file.
+ */
+bool
+results_End(void)
+{
+    size_t i;
+    if (results.format == ResultFormat_JSON) {
+        fputc('{', results.file);
+        for (i = 0; i < results.numFields; i++) {
+            if (i > 0) {
+                fputc(',', results.file);
+            }
+            _results_WriteJSONString(results.keys[i]);
+            fputc(':', results.file);
+            if (results.quoted[i]) {
+                _results_WriteJSONString(results.values[i]);
+            } else {
+                fputs(results.values[i], results.file);
+            }
+        }
+        fputs("}\n", results.file);
+    } else {
+        char header[RESULTS_HEADER_LENGTH];
+        size_t length = 0;
+        for (i = 0; i < results.numFields && length < sizeof(header); i++) {
+            length += snprintf(header + length, sizeof(header) - length, i > 0 ? ",%s" : "%s", results.keys[i]);
+        }
+        if (results.header[0] == '\0') {
+            fprintf(results.file, "%s\n", header);
+            snprintf(results.header, sizeof(results.header), "%s", header);
+        } else if (strcmp(header, results.header) != 0) {
+            fprintf(stderr, "The result columns differ from the header of the CSV file; not appending\n");
+            fprintf(stderr, "  file:   %s\n  record: %s\n", results.header, header);
+            return false;
+        }
+        for (i = 0; i < results.numFields; i++) {
+            if (i > 0) {
+                fputc(',', results.file);
+            }
+            _results_WriteCSVField(results.values[i]);
+        }
+        fputc('\n', results.file);
+    }
+    fflush(results.file);
+    return true;
+}
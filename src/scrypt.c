@@ -1,13 +1,27 @@
-#include <libscrypt.h>
+#include <sodium.h>
 
 #include <parc/algol/parc_Buffer.h>
-#include <parc/security/parc_SecureRandom.h>
+#include <parc/algol/parc_Memory.h>
 #include <parc/security/parc_CryptoHasher.h>
 
+#include <string.h>
+
 int scrypt_N = (1 << 14);
 int scrypt_r = 8;
 int scrypt_p = 1;
 
+#define SCRYPT_HASH_LENGTH 32
+#define SCRYPT_SALT_LENGTH 16
+
+// Digest and salt are stored inline and outputBuffer is a view of the digest
+// created once, so Init, Update and Finalize never allocate. Update computes the
+// digest in place, so the buffer returned by Finalize is only valid until the
+// next Update; FinalizeInto copies the digest out instead.
+//
+// scrypt (RFC 7914) is computed here rather than by a library so that its
+// working memory, the 128 * r * N byte V array plus the B and XY blocks, lives
+// in a scratch buffer owned by the hasher. It is allocated on the first Update
+// and reused by every later one, so large N costs one allocation per hasher.
 typedef struct {
     int hashLength;
     int saltLength;
@@ -16,11 +30,30 @@ typedef struct {
     uint32_t r;
     uint32_t p;
 
+    uint8_t digest[SCRYPT_HASH_LENGTH];
+    uint8_t salt[SCRYPT_SALT_LENGTH];
     PARCBuffer *outputBuffer;
-    PARCBuffer *saltBuffer;
-    PARCSecureRandom *rng;
+
+    uint32_t *scratch;
+    size_t scratchLength;   // bytes
 } scryptHasher;
 
+/**
+ * Whether (N, r, p) is a valid scrypt cost: N a power of two above 1, and the
+ * block sizes small enough to address.
+ */
+bool
+scrypt_ValidParameters(uint64_t N, uint32_t r, uint32_t p)
+{
+    if (N < 2 || (N & (N - 1)) != 0 || r == 0 || p == 0) {
+        return false;
+    }
+    if ((uint64_t) r * p >= (1ULL << 30) || N > SIZE_MAX / 128 / r) {
+        return false;
+    }
+    return true;
+}
+
 static bool
 _scryptHasher_Destructor(scryptHasher **hasherPtr)
 {
@@ -28,10 +61,9 @@ _scryptHasher_Destructor(scryptHasher **hasherPtr)
     if (hasher->outputBuffer != NULL) {
         parcBuffer_Release(&hasher->outputBuffer);
     }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
+    if (hasher->scratch != NULL) {
+        parcMemory_Deallocate(&hasher->scratch);
     }
-    parcSecureRandom_Release(&hasher->rng);
     return true;
 }
 
@@ -41,18 +73,21 @@ parcObject_Override(scryptHasher, PARCObject,
 scryptHasher *
 scryptHasher_Create(void *env)
 {
-    scryptHasher *hasher = parcObject_CreateInstance(Argon2Hasher);
+    scryptHasher *hasher = parcObject_CreateInstance(scryptHasher);
     if (hasher != NULL) {
-        hasher->hashLength = 32;
-        hasher->saltLength = 16;
+        hasher->hashLength = SCRYPT_HASH_LENGTH;
+        hasher->saltLength = SCRYPT_SALT_LENGTH;
 
         hasher->N = scrypt_N;
         hasher->r = scrypt_r;
         hasher->p = scrypt_p;
 
-        hasher->rng = parcSecureRandom_Create();
-        hasher->outputBuffer = NULL;
-        hasher->saltBuffer = NULL;
+        memset(hasher->digest, 0, sizeof(hasher->digest));
+        memset(hasher->salt, 0, sizeof(hasher->salt));
+        hasher->outputBuffer = parcBuffer_Wrap(hasher->digest, SCRYPT_HASH_LENGTH, 0, SCRYPT_HASH_LENGTH);
+
+        hasher->scratch = NULL;
+        hasher->scratchLength = 0;
     }
     return hasher;
 }
@@ -60,29 +95,189 @@ scryptHasher_Create(void *env)
 int
 scryptHasher_Init(scryptHasher *hasher)
 {
-    if (hasher->outputBuffer != NULL) {
-        parcBuffer_Release(&hasher->outputBuffer);
+    // A fresh salt per hash, drawn straight into the hasher, unless it is keyed
+    if (!keyedSalt_Enabled()) {
+        randombytes_buf(hasher->salt, hasher->saltLength);
+    }
+    return 0;
+}
+
+static uint32_t
+_scrypt_Load32(const uint8_t *bytes)
+{
+    return ((uint32_t) bytes[0]) | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static void
+_scrypt_Store32(uint8_t *bytes, uint32_t word)
+{
+    bytes[0] = (uint8_t) word;
+    bytes[1] = (uint8_t) (word >> 8);
+    bytes[2] = (uint8_t) (word >> 16);
+    bytes[3] = (uint8_t) (word >> 24);
+}
+
+#define SCRYPT_ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+// Salsa20/8 core, in place
+static void
+_scrypt_Salsa208(uint32_t block[16])
+{
+    uint32_t x[16];
+    memcpy(x, block, sizeof(x));
+    int i;
+    for (i = 0; i < 8; i += 2) {
+        x[ 4] ^= SCRYPT_ROTL(x[ 0] + x[12],  7);  x[ 8] ^= SCRYPT_ROTL(x[ 4] + x[ 0],  9);
+        x[12] ^= SCRYPT_ROTL(x[ 8] + x[ 4], 13);  x[ 0] ^= SCRYPT_ROTL(x[12] + x[ 8], 18);
+        x[ 9] ^= SCRYPT_ROTL(x[ 5] + x[ 1],  7);  x[13] ^= SCRYPT_ROTL(x[ 9] + x[ 5],  9);
+        x[ 1] ^= SCRYPT_ROTL(x[13] + x[ 9], 13);  x[ 5] ^= SCRYPT_ROTL(x[ 1] + x[13], 18);
+        x[14] ^= SCRYPT_ROTL(x[10] + x[ 6],  7);  x[ 2] ^= SCRYPT_ROTL(x[14] + x[10],  9);
+        x[ 6] ^= SCRYPT_ROTL(x[ 2] + x[14], 13);  x[10] ^= SCRYPT_ROTL(x[ 6] + x[ 2], 18);
+        x[ 3] ^= SCRYPT_ROTL(x[15] + x[11],  7);  x[ 7] ^= SCRYPT_ROTL(x[ 3] + x[15],  9);
+        x[11] ^= SCRYPT_ROTL(x[ 7] + x[ 3], 13);  x[15] ^= SCRYPT_ROTL(x[11] + x[ 7], 18);
+
+        x[ 1] ^= SCRYPT_ROTL(x[ 0] + x[ 3],  7);  x[ 2] ^= SCRYPT_ROTL(x[ 1] + x[ 0],  9);
+        x[ 3] ^= SCRYPT_ROTL(x[ 2] + x[ 1], 13);  x[ 0] ^= SCRYPT_ROTL(x[ 3] + x[ 2], 18);
+        x[ 6] ^= SCRYPT_ROTL(x[ 5] + x[ 4],  7);  x[ 7] ^= SCRYPT_ROTL(x[ 6] + x[ 5],  9);
+        x[ 4] ^= SCRYPT_ROTL(x[ 7] + x[ 6], 13);  x[ 5] ^= SCRYPT_ROTL(x[ 4] + x[ 7], 18);
+        x[11] ^= SCRYPT_ROTL(x[10] + x[ 9],  7);  x[ 8] ^= SCRYPT_ROTL(x[11] + x[10],  9);
+        x[ 9] ^= SCRYPT_ROTL(x[ 8] + x[11], 13);  x[10] ^= SCRYPT_ROTL(x[ 9] + x[ 8], 18);
+        x[12] ^= SCRYPT_ROTL(x[15] + x[14],  7);  x[13] ^= SCRYPT_ROTL(x[12] + x[15],  9);
+        x[14] ^= SCRYPT_ROTL(x[13] + x[12], 13);  x[15] ^= SCRYPT_ROTL(x[14] + x[13], 18);
+    }
+    for (i = 0; i < 16; i++) {
+        block[i] += x[i];
+    }
+}
+
+// BlockMix: out = the 2r mixed 64-byte blocks of in, evens first then odds
+static void
+_scrypt_BlockMix(const uint32_t *in, uint32_t *out, uint32_t r)
+{
+    uint32_t x[16];
+    memcpy(x, &in[(2 * r - 1) * 16], sizeof(x));
+    uint32_t i;
+    int k;
+    for (i = 0; i < 2 * r; i++) {
+        for (k = 0; k < 16; k++) {
+            x[k] ^= in[i * 16 + k];
+        }
+        _scrypt_Salsa208(x);
+        memcpy(&out[((i / 2) + (i & 1) * r) * 16], x, sizeof(x));
+    }
+}
+
+// ROMix of one 128r-byte block of B, using V (32rN words) and XY (64r words)
+static void
+_scrypt_ROMix(uint8_t *block, uint32_t r, uint32_t N, uint32_t *V, uint32_t *XY)
+{
+    size_t words = 32 * (size_t) r;
+    uint32_t *X = XY;
+    uint32_t *Y = XY + words;
+    size_t k;
+    uint32_t i;
+
+    for (k = 0; k < words; k++) {
+        X[k] = _scrypt_Load32(&block[4 * k]);
     }
-    if (hasher->saltBuffer != NULL) {
-        parcBuffer_Release(&hasher->saltBuffer);
+
+    // N is even, so two steps per iteration leave the state back in X
+    for (i = 0; i < N; i += 2) {
+        memcpy(&V[i * words], X, words * sizeof(uint32_t));
+        _scrypt_BlockMix(X, Y, r);
+        memcpy(&V[(i + 1) * words], Y, words * sizeof(uint32_t));
+        _scrypt_BlockMix(Y, X, r);
     }
+    for (i = 0; i < N; i += 2) {
+        uint32_t j = X[(2 * r - 1) * 16] & (N - 1);
+        for (k = 0; k < words; k++) {
+            X[k] ^= V[j * words + k];
+        }
+        _scrypt_BlockMix(X, Y, r);
 
-    hasher->outputBuffer = parcBuffer_Allocate(hasher->hashLength);
-    hasher->saltBuffer = parcBuffer_Allocate(hasher->saltLength);
+        j = Y[(2 * r - 1) * 16] & (N - 1);
+        for (k = 0; k < words; k++) {
+            Y[k] ^= V[j * words + k];
+        }
+        _scrypt_BlockMix(Y, X, r);
+    }
 
-    return 0;
+    for (k = 0; k < words; k++) {
+        _scrypt_Store32(&block[4 * k], X[k]);
+    }
+}
+
+// PBKDF2-HMAC-SHA256 with a single iteration, which is all scrypt uses
+static void
+_scrypt_PBKDF2(const uint8_t *password, size_t passwordLength, const uint8_t *salt, size_t saltLength,
+               uint8_t *output, size_t outputLength)
+{
+    crypto_auth_hmacsha256_state keyed;
+    crypto_auth_hmacsha256_init(&keyed, password, passwordLength);
+
+    uint32_t blockIndex;
+    size_t offset;
+    for (offset = 0, blockIndex = 1; offset < outputLength; offset += crypto_auth_hmacsha256_BYTES, blockIndex++) {
+        crypto_auth_hmacsha256_state state = keyed;
+        uint8_t counter[4] = { blockIndex >> 24, blockIndex >> 16, blockIndex >> 8, blockIndex };
+        uint8_t block[crypto_auth_hmacsha256_BYTES];
+
+        crypto_auth_hmacsha256_update(&state, salt, saltLength);
+        crypto_auth_hmacsha256_update(&state, counter, sizeof(counter));
+        crypto_auth_hmacsha256_final(&state, block);
+
+        size_t length = outputLength - offset < sizeof(block) ? outputLength - offset : sizeof(block);
+        memcpy(output + offset, block, length);
+    }
+    sodium_memzero(&keyed, sizeof(keyed));
 }
 
 // http://stackoverflow.com/questions/11126315/what-are-optimal-scrypt-work-factors
-// make LDFLAGS= CFLAGS_EXTRA=
 int
 scryptHasher_Update(scryptHasher *hasher, const void *buffer, size_t length)
 {
-    const uint8_t *salt = parcBuffer_Overlay(hasher->saltBuffer, 0);
-    uint8_t *hash = parcBuffer_Overlay(hasher->outputBuffer, 0);
-    int result = libscrypt_scrypt(buffer, length, salt, hasher->saltLength, SCRYPT_N,
-                SCRYPT_r, SCRYPT_p, hash, hasher->hashLength);
-    return result;
+    if (!scrypt_ValidParameters(hasher->N, hasher->r, hasher->p)) {
+        return -1;
+    }
+    if (keyedSalt_Enabled()) {
+        keyedSalt_Derive(buffer, length, hasher->salt, hasher->saltLength);
+    }
+
+    // Scratch layout: B (128rp bytes), XY (256r bytes), V (128rN bytes)
+    size_t blockLength = 128 * (size_t) hasher->r;
+    size_t needed = blockLength * hasher->p + 2 * blockLength + blockLength * hasher->N;
+    if (needed > hasher->scratchLength) {
+        if (hasher->scratch != NULL) {
+            parcMemory_Deallocate(&hasher->scratch);
+        }
+        hasher->scratch = parcMemory_Allocate(needed);
+        if (hasher->scratch == NULL) {
+            hasher->scratchLength = 0;
+            return -1;
+        }
+        hasher->scratchLength = needed;
+    }
+    uint8_t *B = (uint8_t *) hasher->scratch;
+    uint32_t *XY = (uint32_t *) (B + blockLength * hasher->p);
+    uint32_t *V = XY + 2 * blockLength / sizeof(uint32_t);
+
+    _scrypt_PBKDF2(buffer, length, hasher->salt, hasher->saltLength, B, blockLength * hasher->p);
+    uint32_t i;
+    for (i = 0; i < hasher->p; i++) {
+        _scrypt_ROMix(B + i * blockLength, hasher->r, hasher->N, V, XY);
+    }
+    _scrypt_PBKDF2(buffer, length, B, blockLength * hasher->p, hasher->digest, hasher->hashLength);
+    return 0;
+}
+
+/**
+ * Copy the digest of the last Update into the caller's digest, which must hold
+ * SCRYPT_HASH_LENGTH bytes.
+ */
+void
+scryptHasher_FinalizeInto(scryptHasher *hasher, uint8_t *digest)
+{
+    memcpy(digest, hasher->digest, hasher->hashLength);
 }
 
 PARCBuffer *
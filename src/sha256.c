@@ -1,6 +1,8 @@
 #include <parc/algol/parc_Buffer.h>
 #include <parc/security/parc_CryptoHasher.h>
 
+#include <string.h>
+
 #ifdef __APPLE__
 #include <CommonCrypto/CommonDigest.h>
 
@@ -31,9 +33,14 @@
 #define LENGTH_SHA512 SHA512_DIGEST_LENGTH
 #endif
 
+// The context and digest live inside the hasher, and outputBuffer is a view of
+// the digest created once, so Init, Update and Finalize never allocate. The
+// buffer returned by Finalize is only valid until the next Finalize;
+// FinalizeInto writes the digest to the caller's memory instead.
 typedef struct {
+    CTX_SHA256 ctx;
+    uint8_t digest[LENGTH_SHA256];
     PARCBuffer *outputBuffer;
-    CTX_SHA256 *ctx;
 } SHA2562Hasher;
 
 static bool
@@ -52,10 +59,10 @@ parcObject_Override(SHA2562Hasher, PARCObject,
 SHA2562Hasher *
 sha256Hasher_Create(void *env)
 {
-    SHA2562Hasher *hasher = parcObject_CreateInstance(Argon2Hasher);
+    SHA2562Hasher *hasher = parcObject_CreateInstance(SHA2562Hasher);
     if (hasher != NULL) {
-        hasher->outputBuffer = NULL;
-        hasher->ctx = parcMemory_AllocateAndClear(sizeof(CTX_SHA256));
+        memset(hasher->digest, 0, LENGTH_SHA256);
+        hasher->outputBuffer = parcBuffer_Wrap(hasher->digest, LENGTH_SHA256, 0, LENGTH_SHA256);
     }
     return hasher;
 }
@@ -63,23 +70,28 @@ sha256Hasher_Create(void *env)
 int
 sha256Hasher_Init(SHA2562Hasher *hasher)
 {
-    if (hasher->outputBuffer != NULL) {
-        parcBuffer_Release(&hasher->outputBuffer);
-    }
-    hasher->outputBuffer = parcBuffer_Allocate(LENGTH_SHA256);
-    return INIT_SHA256(hasher->ctx);
+    return INIT_SHA256(&hasher->ctx);
 }
 
 int
 sha256Hasher_Update(SHA2562Hasher *hasher, const void *buffer, size_t length)
 {
-    return UPDATE_SHA256(hasher->ctx, buffer, (unsigned) length);
+    return UPDATE_SHA256(&hasher->ctx, buffer, (unsigned) length);
+}
+
+/**
+ * Finish the hash into the caller's digest, which must hold LENGTH_SHA256 bytes.
+ */
+void
+sha256Hasher_FinalizeInto(SHA2562Hasher *hasher, uint8_t *digest)
+{
+    FINAL_SHA256(digest, &hasher->ctx);
 }
 
 PARCBuffer *
 sha256Hasher_Finalize(SHA2562Hasher *hasher)
 {
-    FINAL_SHA256(parcBuffer_Overlay(hasher->outputBuffer, 0), hasher->ctx);
+    sha256Hasher_FinalizeInto(hasher, hasher->digest);
     return parcBuffer_Acquire(hasher->outputBuffer);
 }
 
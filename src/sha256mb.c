@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// Multi-buffer SHA-256: hashes many independent messages at once, one message
+// per SIMD lane. Expects sha256.c to be included first (CTX_SHA256 et al.).
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    uint8_t *digest; // LENGTH_SHA256 bytes
+} SHA256MultiBufferJob;
+
+typedef enum {
+    SHA256MultiBufferKernel_Scalar = 0x00,
+    SHA256MultiBufferKernel_SHANI = 0x01,
+    SHA256MultiBufferKernel_SSE4 = 0x02,
+    SHA256MultiBufferKernel_AVX2 = 0x03,
+    SHA256MultiBufferKernel_AVX512 = 0x04,
+} SHA256MultiBufferKernel;
+
+typedef struct {
+    SHA256MultiBufferJob *job;
+    size_t block;
+    size_t fullBlocks;
+    size_t totalBlocks;
+    uint8_t tail[128]; // the padded final one or two blocks
+} _SHA256MultiBufferLane;
+
+static const uint32_t _sha256mb_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t _sha256mb_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint8_t _sha256mb_IdleBlock[64] = { 0 };
+
+#define SHA256MB_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void
+_sha256mb_LaneStart(_SHA256MultiBufferLane *lane, SHA256MultiBufferJob *job, uint32_t *state, int lanes, int l)
+{
+    size_t remainder = job->length % 64;
+    uint64_t bits = (uint64_t) job->length * 8;
+    int i;
+
+    lane->job = job;
+    lane->block = 0;
+    lane->fullBlocks = job->length / 64;
+    lane->totalBlocks = lane->fullBlocks + (remainder + 9 > 64 ? 2 : 1);
+
+    size_t tailLength = (lane->totalBlocks - lane->fullBlocks) * 64;
+    memset(lane->tail, 0, sizeof(lane->tail));
+    memcpy(lane->tail, job->data + lane->fullBlocks * 64, remainder);
+    lane->tail[remainder] = 0x80;
+    for (i = 0; i < 8; i++) {
+        lane->tail[tailLength - 1 - i] = (uint8_t) (bits >> (8 * i));
+    }
+
+    for (i = 0; i < 8; i++) {
+        state[i * lanes + l] = _sha256mb_IV[i];
+    }
+}
+
+static const uint8_t *
+_sha256mb_LaneBlock(_SHA256MultiBufferLane *lane)
+{
+    if (lane->job == NULL) {
+        return _sha256mb_IdleBlock;
+    } else if (lane->block < lane->fullBlocks) {
+        return lane->job->data + lane->block * 64;
+    }
+    return lane->tail + (lane->block - lane->fullBlocks) * 64;
+}
+
+static void
+_sha256mb_LaneFinish(_SHA256MultiBufferLane *lane, uint32_t *state, int lanes, int l)
+{
+    int i;
+    for (i = 0; i < 8; i++) {
+        uint32_t word = state[i * lanes + l];
+        lane->job->digest[4 * i] = (uint8_t) (word >> 24);
+        lane->job->digest[4 * i + 1] = (uint8_t) (word >> 16);
+        lane->job->digest[4 * i + 2] = (uint8_t) (word >> 8);
+        lane->job->digest[4 * i + 3] = (uint8_t) word;
+    }
+    lane->job = NULL;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256MB_X86 1
+#endif
+
+#define SHA256MB_LANES 4
+#define SHA256MB_NAME(suffix) _sha256mb4 ## suffix
+#ifdef SHA256MB_X86
+#define SHA256MB_TARGET __attribute__((target("sse4.1")))
+#else
+#define SHA256MB_TARGET
+#endif
+#include "sha256mb_kernel.c"
+#undef SHA256MB_LANES
+#undef SHA256MB_NAME
+#undef SHA256MB_TARGET
+
+#ifdef SHA256MB_X86
+#define SHA256MB_LANES 8
+#define SHA256MB_NAME(suffix) _sha256mb8 ## suffix
+#define SHA256MB_TARGET __attribute__((target("avx2")))
+#include "sha256mb_kernel.c"
+#undef SHA256MB_LANES
+#undef SHA256MB_NAME
+#undef SHA256MB_TARGET
+
+#define SHA256MB_LANES 16
+#define SHA256MB_NAME(suffix) _sha256mb16 ## suffix
+#define SHA256MB_TARGET __attribute__((target("avx512f")))
+#include "sha256mb_kernel.c"
+#undef SHA256MB_LANES
+#undef SHA256MB_NAME
+#undef SHA256MB_TARGET
+#endif
+
+static void
+_sha256mb_RunScalar(SHA256MultiBufferJob *jobs, size_t count)
+{
+    CTX_SHA256 ctx;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        INIT_SHA256(&ctx);
+        UPDATE_SHA256(&ctx, jobs[i].data, (unsigned) jobs[i].length);
+        FINAL_SHA256(jobs[i].digest, &ctx);
+    }
+}
+
+typedef void (*_SHA256MultiBufferRun)(SHA256MultiBufferJob *jobs, size_t count);
+
+static _SHA256MultiBufferRun
+_sha256mb_KernelRun(SHA256MultiBufferKernel kernel)
+{
+    switch (kernel) {
+        case SHA256MultiBufferKernel_SSE4:
+            return _sha256mb4_Run;
+#ifdef SHA256MB_X86
+        case SHA256MultiBufferKernel_AVX2:
+            return _sha256mb8_Run;
+        case SHA256MultiBufferKernel_AVX512:
+            return _sha256mb16_Run;
+#endif
+        default:
+            return _sha256mb_RunScalar;
+    }
+}
+
+// Jobs a kernel hashes at once; smaller batches leave lanes idle
+static size_t
+_sha256mb_KernelLanes(SHA256MultiBufferKernel kernel)
+{
+    switch (kernel) {
+        case SHA256MultiBufferKernel_SSE4:
+            return 4;
+        case SHA256MultiBufferKernel_AVX2:
+            return 8;
+        case SHA256MultiBufferKernel_AVX512:
+            return 16;
+        default:
+            return 1;
+    }
+}
+
+#define SHA256MB_CALIBRATION_JOBS 64
+#define SHA256MB_CALIBRATION_LENGTH 48  // one block, like most name prefixes
+#define SHA256MB_CALIBRATION_ROUNDS 8
+
+// Best of a few timed runs of kernel over jobs, in nanoseconds
+static uint64_t
+_sha256mb_Time(SHA256MultiBufferKernel kernel, SHA256MultiBufferJob *jobs, size_t count)
+{
+    _SHA256MultiBufferRun run = _sha256mb_KernelRun(kernel);
+    uint64_t best = UINT64_MAX;
+    int round;
+    for (round = 0; round < SHA256MB_CALIBRATION_ROUNDS; round++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run(jobs, count);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        uint64_t elapsed = (uint64_t) (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+static int sha256MultiBufferKernel = -1;
+
+/**
+ * Pick the fastest kernel the CPU supports for full batches. The one-at-a-time
+ * path runs the system SHA-256 library, which uses SHA-NI where the CPU has it
+ * and can then match or beat the lane kernels, so every candidate is timed once
+ * on a batch of short messages instead of ranking them by width.
+ */
+SHA256MultiBufferKernel
+sha256MultiBuffer_SelectKernel()
+{
+    if (sha256MultiBufferKernel < 0) {
+        SHA256MultiBufferKernel best = SHA256MultiBufferKernel_Scalar;
+        SHA256MultiBufferKernel candidates[3];
+        int numCandidates = 0;
+#ifdef SHA256MB_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sha")) {
+            best = SHA256MultiBufferKernel_SHANI;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            candidates[numCandidates++] = SHA256MultiBufferKernel_SSE4;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            candidates[numCandidates++] = SHA256MultiBufferKernel_AVX2;
+        }
+        if (__builtin_cpu_supports("avx512f")) {
+            candidates[numCandidates++] = SHA256MultiBufferKernel_AVX512;
+        }
+#else
+        candidates[numCandidates++] = SHA256MultiBufferKernel_SSE4;
+#endif
+
+        uint8_t data[SHA256MB_CALIBRATION_JOBS * SHA256MB_CALIBRATION_LENGTH];
+        uint8_t digests[SHA256MB_CALIBRATION_JOBS * LENGTH_SHA256];
+        SHA256MultiBufferJob jobs[SHA256MB_CALIBRATION_JOBS];
+        memset(data, 0, sizeof(data));
+        int i;
+        for (i = 0; i < SHA256MB_CALIBRATION_JOBS; i++) {
+            jobs[i].data = data + i * SHA256MB_CALIBRATION_LENGTH;
+            jobs[i].length = SHA256MB_CALIBRATION_LENGTH;
+            jobs[i].digest = digests + i * LENGTH_SHA256;
+        }
+
+        uint64_t bestTime = _sha256mb_Time(best, jobs, SHA256MB_CALIBRATION_JOBS);
+        for (i = 0; i < numCandidates; i++) {
+            uint64_t time = _sha256mb_Time(candidates[i], jobs, SHA256MB_CALIBRATION_JOBS);
+            if (time < bestTime) {
+                best = candidates[i];
+                bestTime = time;
+            }
+        }
+        sha256MultiBufferKernel = best;
+    }
+    return (SHA256MultiBufferKernel) sha256MultiBufferKernel;
+}
+
+const char *
+sha256MultiBuffer_KernelName(SHA256MultiBufferKernel kernel)
+{
+    switch (kernel) {
+        case SHA256MultiBufferKernel_SHANI:
+            return "sha-ni";
+        case SHA256MultiBufferKernel_SSE4:
+            return "sse4x4";
+        case SHA256MultiBufferKernel_AVX2:
+            return "avx2x8";
+        case SHA256MultiBufferKernel_AVX512:
+            return "avx512x16";
+        default:
+            return "scalar";
+    }
+}
+
+/**
+ * Hash every job with the selected kernel, or one at a time when there are too
+ * few jobs to fill its lanes.
+ */
+void
+sha256MultiBuffer_Hash(SHA256MultiBufferJob *jobs, size_t count)
+{
+    SHA256MultiBufferKernel kernel = sha256MultiBuffer_SelectKernel();
+    if (count < _sha256mb_KernelLanes(kernel)) {
+        kernel = SHA256MultiBufferKernel_Scalar;
+    }
+    _sha256mb_KernelRun(kernel)(jobs, count);
+}
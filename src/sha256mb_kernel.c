@@ -0,0 +1,110 @@
+// Multi-buffer SHA-256 kernel template, included once per lane width by sha256mb.c.
+// The includer defines SHA256MB_LANES, SHA256MB_NAME(suffix) and SHA256MB_TARGET.
+// Every round is written as a loop over lanes so the compiler can keep one lane
+// per vector element for the instruction set named in SHA256MB_TARGET.
+
+SHA256MB_TARGET static void
+SHA256MB_NAME(_Compress)(uint32_t state[8][SHA256MB_LANES], const uint8_t *blocks[SHA256MB_LANES])
+{
+    uint32_t w[64][SHA256MB_LANES];
+    uint32_t a[SHA256MB_LANES], b[SHA256MB_LANES], c[SHA256MB_LANES], d[SHA256MB_LANES];
+    uint32_t e[SHA256MB_LANES], f[SHA256MB_LANES], g[SHA256MB_LANES], h[SHA256MB_LANES];
+    int t, l;
+
+    for (t = 0; t < 16; t++) {
+        for (l = 0; l < SHA256MB_LANES; l++) {
+            const uint8_t *p = blocks[l] + 4 * t;
+            w[t][l] = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+        }
+    }
+    for (t = 16; t < 64; t++) {
+        for (l = 0; l < SHA256MB_LANES; l++) {
+            uint32_t s0 = SHA256MB_ROTR(w[t - 15][l], 7) ^ SHA256MB_ROTR(w[t - 15][l], 18) ^ (w[t - 15][l] >> 3);
+            uint32_t s1 = SHA256MB_ROTR(w[t - 2][l], 17) ^ SHA256MB_ROTR(w[t - 2][l], 19) ^ (w[t - 2][l] >> 10);
+            w[t][l] = w[t - 16][l] + s0 + w[t - 7][l] + s1;
+        }
+    }
+
+    for (l = 0; l < SHA256MB_LANES; l++) {
+        a[l] = state[0][l];
+        b[l] = state[1][l];
+        c[l] = state[2][l];
+        d[l] = state[3][l];
+        e[l] = state[4][l];
+        f[l] = state[5][l];
+        g[l] = state[6][l];
+        h[l] = state[7][l];
+    }
+
+    for (t = 0; t < 64; t++) {
+        for (l = 0; l < SHA256MB_LANES; l++) {
+            uint32_t S1 = SHA256MB_ROTR(e[l], 6) ^ SHA256MB_ROTR(e[l], 11) ^ SHA256MB_ROTR(e[l], 25);
+            uint32_t ch = (e[l] & f[l]) ^ (~e[l] & g[l]);
+            uint32_t t1 = h[l] + S1 + ch + _sha256mb_K[t] + w[t][l];
+            uint32_t S0 = SHA256MB_ROTR(a[l], 2) ^ SHA256MB_ROTR(a[l], 13) ^ SHA256MB_ROTR(a[l], 22);
+            uint32_t maj = (a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]);
+            uint32_t t2 = S0 + maj;
+            h[l] = g[l];
+            g[l] = f[l];
+            f[l] = e[l];
+            e[l] = d[l] + t1;
+            d[l] = c[l];
+            c[l] = b[l];
+            b[l] = a[l];
+            a[l] = t1 + t2;
+        }
+    }
+
+    for (l = 0; l < SHA256MB_LANES; l++) {
+        state[0][l] += a[l];
+        state[1][l] += b[l];
+        state[2][l] += c[l];
+        state[3][l] += d[l];
+        state[4][l] += e[l];
+        state[5][l] += f[l];
+        state[6][l] += g[l];
+        state[7][l] += h[l];
+    }
+}
+
+SHA256MB_TARGET static void
+SHA256MB_NAME(_Run)(SHA256MultiBufferJob *jobs, size_t count)
+{
+    _SHA256MultiBufferLane lanes[SHA256MB_LANES];
+    uint32_t state[8][SHA256MB_LANES];
+    const uint8_t *blocks[SHA256MB_LANES];
+    size_t next = 0;
+    int active = 0;
+    int l;
+
+    // Prime every lane with a job; lanes without work hash the idle block from a
+    // zero state, and their result is dropped
+    memset(state, 0, sizeof(state));
+    for (l = 0; l < SHA256MB_LANES; l++) {
+        lanes[l].job = NULL;
+        if (next < count) {
+            _sha256mb_LaneStart(&lanes[l], &jobs[next++], &state[0][0], SHA256MB_LANES, l);
+            active++;
+        }
+    }
+
+    while (active > 0) {
+        for (l = 0; l < SHA256MB_LANES; l++) {
+            blocks[l] = _sha256mb_LaneBlock(&lanes[l]);
+        }
+
+        SHA256MB_NAME(_Compress)(state, blocks);
+
+        // Retire finished lanes and refill them from the job list
+        for (l = 0; l < SHA256MB_LANES; l++) {
+            if (lanes[l].job != NULL && ++lanes[l].block == lanes[l].totalBlocks) {
+                _sha256mb_LaneFinish(&lanes[l], &state[0][0], SHA256MB_LANES, l);
+                active--;
+                if (next < count) {
+                    _sha256mb_LaneStart(&lanes[l], &jobs[next++], &state[0][0], SHA256MB_LANES, l);
+                    active++;
+                }
+            }
+        }
+    }
+}
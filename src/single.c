@@ -10,9 +10,20 @@
 #include <parc/security/parc_CryptoHasher.h>
 #include <parc/security/parc_SecureRandom.h>
 
+#include "keyedsalt.c"
+#include "hashpool.c"
+#include "blockpool.c"
 #include "argon2.c"
 #include "scrypt.c"
+#include "balloon.c"
+#include "cycletimer.c"
+#include "perfcounters.c"
+#include "buildinfo.c"
 #include "sha256.c"
+#include "histogram.c"
+#include "benchoptions.c"
+#include "digesthasher.c"
+#include "hashbench.c"
 
 #define NUM_TRIALS 10
 
@@ -20,49 +31,29 @@ void
 usage(char *prog)
 {
     fprintf(stderr, "%s <alg> (params)\n", prog);
-}
-
-PARCBuffer *
-hashFunction(PARCCryptoHasher *instance, PARCBuffer *buffer)
-{
-    parcCryptoHasher_UpdateBuffer(instance, buffer);
-    PARCCryptoHash *hash = parcCryptoHasher_Finalize(instance);
-    PARCBuffer *digest = parcBuffer_Acquire(parcCryptoHash_GetDigest(hash));
-    parcCryptoHash_Release(&hash);
-    return digest;
+    fprintf(stderr, "   ARGON2 [t m lanes [pool]] | scrypt [N r p] | BALLOON [s t d threads] | SHA256\n");
+    fprintf(stderr, "   TSEC_PERF_COUNTERS=1 also writes the hash's hardware counter totals and per-hash\n");
+    fprintf(stderr, "   averages to stderr as a counters=hash line\n");
 }
 
 double
-profile(PARCCryptoHasher *hasher)
+profile(DigestHasher *hasher)
 {
-    int t;
     PARCSecureRandom *random = parcSecureRandom_Create();
-
-    // Compute an average value for this one entry
-    PARCStopwatch *timer = parcStopwatch_Create();
-    parcStopwatch_Start(timer);
-    uint64_t totalTime = 0;
-    for (t = 0; t < NUM_TRIALS; t++) {
-        fprintf(stderr, "Trial %d\n", t);
-        // Generate the input buffer to be hashed
-        PARCBuffer *input = parcBuffer_Allocate(32);
-        parcSecureRandom_NextBytes(random, input);
-        parcCryptoHasher_Init(hasher);
-
-        // Compute the hash of the input
-        uint64_t startTime = parcStopwatch_ElapsedTimeNanos(timer);
-        PARCBuffer *output = hashFunction(hasher, input);
-        uint64_t endTime = parcStopwatch_ElapsedTimeNanos(timer);
-
-        totalTime += (endTime - startTime);
-
-        parcBuffer_Release(&output);
-        parcBuffer_Release(&input);
+    HashBenchResult *result = parcMemory_Allocate(sizeof(HashBenchResult));
+    hashBench_Run(hasher, random, 32, NUM_TRIALS, true, result);
+
+    // The time goes to stdout for the optimizer; counters go to stderr
+    if (perfCounters_Enabled()) {
+        fprintf(stderr, "counters=hash");
+        perfSample_PrintFields(stderr, &result->counts, NUM_TRIALS);
+        fprintf(stderr, "\n");
+        perfCounters_ReportMissing();
     }
-    parcStopwatch_Release(&timer);
 
-    // Append the results
-    double average = ((double) totalTime) / NUM_TRIALS;
+    double average = hashBenchResult_Mean(result);
+    parcMemory_Deallocate(&result);
+    parcSecureRandom_Release(&random);
     return average;
 }
 
@@ -70,6 +61,7 @@ int
 main(int argc, char **argv)
 {
     int i;
+    buildInfo_Report();
     if (argc < 2) {
         for (i = 0; i < argc; i++) {
             printf("%s ", argv[i]);
@@ -79,42 +71,32 @@ main(int argc, char **argv)
     }
 
     argon2_init();
+    balloon_init();
+    cycleTimer_Init();
+    perfCounters_Configure(getenv("TSEC_PERF_COUNTERS") != NULL);
 
     // extract the parameters
-    char *alg = argv[1];
-
-    // switch on the algorithm
-    PARCCryptoHasher *hasher;
-    if (strcmp(alg, "SHA256") == 0) {
-        PARCCryptoHasher *sha256Hasher = parcCryptoHasher_CustomHasher(0, functor_sha256);
-        hasher = sha256Hasher;
-        double time = profile(sha256Hasher);
-        printf("%f\n", time);
-    } else if (strcmp(alg, "ARGON2") == 0) {
-        if (argc < 5) {
-            argon2TCost = crypto_pwhash_OPSLIMIT_INTERACTIVE;
-            argon2MCost = crypto_pwhash_MEMLIMIT_INTERACTIVE;
-            argon2DCost = 1;
-        } else {
-            argon2TCost = atoi(argv[2]);
-            argon2MCost = atoi(argv[3]);
-            argon2DCost = atoi(argv[4]);
-        }
-        PARCCryptoHasher *argon2Hasher = parcCryptoHasher_CustomHasher(0, functor_argon2);
-        double averageTime = profile(argon2Hasher);
-        printf("%f\n", averageTime);
-    } else if (strcmp(alg, "scrypt") == 0) {
-        //scrypt_N = atoi(argv[2]);
-        //scrypt_r = atoi(argv[3]);
-        //scrypt_p = atoi(argv[4]);
-        PARCCryptoHasher *scryptHasher = parcCryptoHasher_CustomHasher(0, functor_scrypt);
-        double time = profile(scryptHasher);
-        printf("%f\n", time);
-    } else {
+    int hashAlgorithm = benchOptions_ParseHash(argc - 1, argv + 1);
+    if (hashAlgorithm < 0) {
         for (i = 0; i < argc; i++) {
             printf("%s ", argv[i]);
         }
         usage(argv[0]);
         exit(-2);
     }
+    if (hashAlgorithm == HashType_Argon2 && argc > 5) {
+        // "prefault" or "huge": reuse pre-faulted Argon2 block memory across trials
+        if (strcmp(argv[5], "prefault") != 0 && strcmp(argv[5], "huge") != 0) {
+            fprintf(stderr, "Block pool mode %s is unknown\n", argv[5]);
+            usage(argv[0]);
+            exit(-2);
+        }
+        blockPool_Configure(strcmp(argv[5], "huge") == 0);
+        blockPool_Reserve(argon2MCost, 1);
+    }
+
+    DigestHasher *hasher = digestHasher_Create(hashAlgorithm);
+    double time = profile(hasher);
+    printf("%f\n", time);
+    digestHasher_Release(&hasher);
 }
@@ -0,0 +1,79 @@
+#include <sodium.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Chunked content encryption built on libsodium's secretstream
+// (XChaCha20-Poly1305). An object is sealed as a header followed by a sequence
+// of independently authenticated chunks; the last chunk carries the FINAL tag,
+// so truncation and reordering are detected. Neither side ever needs more than
+// one chunk in memory, and a receiver can open chunks as they arrive.
+
+#define STREAM_KEY_LENGTH crypto_secretstream_xchacha20poly1305_KEYBYTES
+#define STREAM_HEADER_LENGTH crypto_secretstream_xchacha20poly1305_HEADERBYTES
+#define STREAM_CHUNK_OVERHEAD crypto_secretstream_xchacha20poly1305_ABYTES
+
+typedef struct {
+    crypto_secretstream_xchacha20poly1305_state state;
+    bool finished;
+} StreamCipher;
+
+/**
+ * Start sealing a new object, writing the STREAM_HEADER_LENGTH byte header that
+ * must precede the first chunk on the wire.
+ */
+bool
+streamCipher_InitSeal(StreamCipher *stream, uint8_t header[STREAM_HEADER_LENGTH], const uint8_t key[STREAM_KEY_LENGTH])
+{
+    stream->finished = false;
+    return crypto_secretstream_xchacha20poly1305_init_push(&stream->state, header, key) == 0;
+}
+
+/**
+ * Seal length bytes into output, which must hold length + STREAM_CHUNK_OVERHEAD
+ * bytes. Pass final for the last chunk of the object.
+ */
+bool
+streamCipher_SealChunk(StreamCipher *stream, uint8_t *output, const uint8_t *input, size_t length, bool final)
+{
+    unsigned char tag = final ? crypto_secretstream_xchacha20poly1305_TAG_FINAL : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+    int result = crypto_secretstream_xchacha20poly1305_push(&stream->state, output, NULL, input, length, NULL, 0, tag);
+    stream->finished = final;
+    return result == 0;
+}
+
+/**
+ * Start opening an object from its header.
+ */
+bool
+streamCipher_InitOpen(StreamCipher *stream, const uint8_t header[STREAM_HEADER_LENGTH], const uint8_t key[STREAM_KEY_LENGTH])
+{
+    stream->finished = false;
+    return crypto_secretstream_xchacha20poly1305_init_pull(&stream->state, header, key) == 0;
+}
+
+/**
+ * Open one sealed chunk of length bytes into output, which must hold
+ * length - STREAM_CHUNK_OVERHEAD bytes. Fails on forged or out-of-order chunks
+ * and on any chunk after the final one; streamCipher_IsFinished reports
+ * whether the object is complete.
+ */
+bool
+streamCipher_OpenChunk(StreamCipher *stream, uint8_t *output, const uint8_t *input, size_t length)
+{
+    unsigned char tag = 0;
+    if (stream->finished || length < STREAM_CHUNK_OVERHEAD) {
+        return false;
+    }
+    if (crypto_secretstream_xchacha20poly1305_pull(&stream->state, output, NULL, &tag, input, length, NULL, 0) != 0) {
+        return false;
+    }
+    stream->finished = (tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL);
+    return true;
+}
+
+bool
+streamCipher_IsFinished(const StreamCipher *stream)
+{
+    return stream->finished;
+}
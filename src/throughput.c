@@ -0,0 +1,136 @@
+#include <time.h>
+#include <errno.h>
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Sustained-throughput accounting.
+//
+// A throughput run pushes names through the pipeline back to back, or at a
+// fixed offered load, for a set time or count. Each worker sums what it
+// processed and how long each stage kept it busy into a Throughput. The totals
+// then give aggregate rates over wall time, and per-core efficiency over busy
+// time: the rate one core would sustain doing nothing but that stage.
+
+typedef struct {
+    uint64_t names;
+    uint64_t nameBytes;
+    uint64_t payloadBytes;
+
+    // Busy time per stage, nanoseconds
+    uint64_t obfuscateTime;
+    uint64_t deobfuscateTime;
+    uint64_t encryptTime;
+    uint64_t decryptTime;
+
+    uint64_t cpuTime;       // CPU time of the worker thread, nanoseconds
+    uint64_t late;          // names started a slot or more late under an offered load
+} Throughput;
+
+// Paces one worker at a fixed rate. Slots are laid out from the start time, so a
+// worker that falls behind catches up back to back instead of drifting.
+typedef struct {
+    uint64_t start;
+    double interval;        // nanoseconds between names; 0 for back to back
+    uint64_t sent;
+} ThroughputPacer;
+
+uint64_t
+throughput_MonotonicNanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+uint64_t
+throughput_ThreadCpuNanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Start pacing at rate names per second; 0 means as fast as possible.
+ */
+void
+throughputPacer_Start(ThroughputPacer *pacer, double rate)
+{
+    pacer->start = throughput_MonotonicNanos();
+    pacer->interval = rate > 0 ? 1e9 / rate : 0;
+    pacer->sent = 0;
+}
+
+/**
+ * Wait for the next name's slot. Returns false if the worker is a slot or more behind.
+ */
+bool
+throughputPacer_Wait(ThroughputPacer *pacer)
+{
+    bool onTime = true;
+    if (pacer->interval > 0) {
+        uint64_t due = pacer->start + (uint64_t) (pacer->sent * pacer->interval);
+        uint64_t now = throughput_MonotonicNanos();
+        if (due > now) {
+            struct timespec delay = { .tv_sec = (due - now) / 1000000000ULL, .tv_nsec = (due - now) % 1000000000ULL };
+            while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+            }
+        } else if (now - due > pacer->interval) {
+            // More than a whole slot behind, not just timer slack
+            onTime = false;
+        }
+    }
+    pacer->sent++;
+    return onTime;
+}
+
+void
+throughput_Add(Throughput *total, const Throughput *part)
+{
+    total->names += part->names;
+    total->nameBytes += part->nameBytes;
+    total->payloadBytes += part->payloadBytes;
+    total->obfuscateTime += part->obfuscateTime;
+    total->deobfuscateTime += part->deobfuscateTime;
+    total->encryptTime += part->encryptTime;
+    total->decryptTime += part->decryptTime;
+    total->cpuTime += part->cpuTime;
+    total->late += part->late;
+}
+
+static double
+_throughput_PerSecond(uint64_t count, uint64_t nanos)
+{
+    return nanos == 0 ? 0.0 : ((double) count) * 1e9 / nanos;
+}
+
+static void
+_throughput_ReportStage(const char *stage, uint64_t names, uint64_t bytes, uint64_t busyTime)
+{
+    printf("stage=%s,busy_ns=%llu,names_per_core_sec=%f,bytes_per_core_sec=%f\n", stage,
+           (unsigned long long) busyTime, _throughput_PerSecond(names, busyTime), _throughput_PerSecond(bytes, busyTime));
+}
+
+/**
+ * Print the totals of a run on threads workers that took wallTime nanoseconds.
+ * offeredLoad is the target in names per second, 0 for back to back. Name
+ * stages count name bytes and content stages count payload bytes.
+ */
+void
+throughput_Report(const Throughput *total, int threads, uint64_t wallTime, double offeredLoad)
+{
+    printf("stage=total,threads=%d,names=%llu,wall_ns=%llu,offered_names_per_sec=%f,late=%llu,"
+           "names_per_sec=%f,payload_bytes_per_sec=%f,gbit_per_sec=%f,cpu_utilization=%f,names_per_core_sec=%f\n",
+           threads, (unsigned long long) total->names, (unsigned long long) wallTime, offeredLoad,
+           (unsigned long long) total->late,
+           _throughput_PerSecond(total->names, wallTime),
+           _throughput_PerSecond(total->payloadBytes, wallTime),
+           wallTime == 0 ? 0.0 : ((double) total->payloadBytes) * 8 / wallTime,
+           wallTime == 0 ? 0.0 : ((double) total->cpuTime) / ((double) wallTime * threads),
+           _throughput_PerSecond(total->names, total->cpuTime));
+    _throughput_ReportStage("obfuscate", total->names, total->nameBytes, total->obfuscateTime);
+    _throughput_ReportStage("deobfuscate", total->names, total->nameBytes, total->deobfuscateTime);
+    _throughput_ReportStage("encrypt", total->names, total->payloadBytes, total->encryptTime);
+    _throughput_ReportStage("decrypt", total->names, total->payloadBytes, total->decryptTime);
+}
@@ -1,527 +1,137 @@
-#include <parc/algol/parc_SafeMemory.h>
-#include <parc/algol/parc_BufferComposer.h>
-#include <parc/algol/parc_LinkedList.h>
-#include <parc/algol/parc_Iterator.h>
-#include <parc/algol/parc_HashMap.h>
+#include "pipeline.c"
 
-#include <parc/developer/parc_Stopwatch.h>
-#include <parc/statistics/parc_BasicStats.h>
-#include <parc/security/parc_SecureRandom.h>
+// tsec prints the pipeline benchmark in its original layouts: one headerless
+// CSV row of latencies, or key=value lines in throughput mode. The bench driver
+// runs the same pipeline and writes self-describing records instead.
 
-#include <ccnx/common/ccnx_Name.h>
-#include <ccnx/common/codec/ccnxCodec_TlvEncoder.h>
-#include <ccnx/common/codec/schema_v1/ccnxCodecSchemaV1_Types.h>
-#include <ccnx/common/codec/schema_v1/ccnxCodecSchemaV1_NameCodec.h>
-
-#include <stdio.h>
-#include <ctype.h>
-
-#include <sodium.h>
-
-#include "argon2.c"
-#include "scrypt.c"
-#include "sha256.c"
-
-typedef struct {
-    PARCBuffer *ciphertext;
-    PARCBuffer *tag;
-    PARCBuffer *IV;
-} CiphertextTag;
-
-static size_t dataSizes[] = {1024, 2048, 4096, 8192};
-static int numDataSizes = sizeof(dataSizes) / sizeof(size_t);
-
-static int
-randomDataSize()
-{
-    uint32_t randomWord = randombytes_random();
-    return dataSizes[randomWord % numDataSizes];
-}
-
-int
-peekFile(FILE *fp)
-{
-    int c = fgetc(fp);
-    ungetc(c, fp);
-    return c;
-}
-
-static PARCSecureRandom *rng;
-
-PARCBufferComposer *
-readLine(FILE *fp)
-{
-    PARCBufferComposer *composer = parcBufferComposer_Create();
-    char curr = fgetc(fp);
-    while ((isalnum(curr) || curr == ':' || curr == '/' || curr == '.' ||
-            curr == '_' || curr == '(' || curr == ')' || curr == '[' ||
-            curr == ']' || curr == '-' || curr == '%' || curr == '+' ||
-            curr == '=' || curr == ';' || curr == '$' || curr == '\'') && curr != EOF) {
-        parcBufferComposer_PutChar(composer, curr);
-        curr = fgetc(fp);
-    }
-    return composer;
-}
-
-static PARCBuffer *
-_encodeName(CCNxName *name)
-{
-    CCNxCodecTlvEncoder *encoder = ccnxCodecTlvEncoder_Create();
-    size_t length = ccnxCodecSchemaV1NameCodec_Encode(encoder, CCNxCodecSchemaV1Types_CCNxMessage_Name, name);
-    PARCBuffer *container = ccnxCodecTlvEncoder_CreateBuffer(encoder);
-    ccnxCodecTlvEncoder_Destroy(&encoder);
-    return container;
-}
-
-static PARCBuffer *
-_hashBuffer(PARCCryptoHasher *hasher, PARCBuffer *buffer)
-{
-    parcCryptoHasher_Init(hasher);
-    parcCryptoHasher_UpdateBuffer(hasher, buffer);
-    PARCCryptoHash *hash = parcCryptoHasher_Finalize(hasher);
-
-    PARCBuffer *digest = parcBuffer_Acquire(parcCryptoHash_GetDigest(hash));
-
-    parcCryptoHash_Release(&hash);
-
-    return digest;
-}
-
-// XXX: encode names using the codec, create TLV from the buffer, use TLV to create final name
-
-static PARCBuffer *
-_obfuscateName(PARCCryptoHasher *hasher, PARCBuffer *encodedName)
-{
-    CCNxCodecTlvDecoder *decoder = ccnxCodecTlvDecoder_Create(encodedName);
-    size_t type = ccnxCodecTlvDecoder_GetType(decoder);
-    size_t length = ccnxCodecTlvDecoder_GetLength(decoder);
-
-    PARCBufferComposer *composer = parcBufferComposer_Create();
-    PARCBufferComposer *fullComposer = parcBufferComposer_Create();
-    parcBufferComposer_PutUint16(fullComposer, type);
-    parcBufferComposer_PutUint16(fullComposer, 0); // need to fill in the length at the end
-
-    size_t offset = 0;
-    while (offset < length) {
-        size_t innerType = ccnxCodecTlvDecoder_GetType(decoder);
-        size_t innerLength = ccnxCodecTlvDecoder_GetLength(decoder);
-        offset += innerLength + 4;
-
-        // Extract and append the segment
-        PARCBuffer *segmentValue = ccnxCodecTlvDecoder_GetValue(decoder, innerLength);
-        parcBufferComposer_PutBuffer(composer, segmentValue);
-
-        // Compute the hash of the segment
-        PARCBuffer *prefixBuffer = parcBufferComposer_CreateBuffer(composer);
-        parcBuffer_Flip(prefixBuffer);
-        PARCBuffer *digest = _hashBuffer(hasher, prefixBuffer);
-
-        // Add the hashed segment to the new name
-        parcBufferComposer_PutUint16(fullComposer, innerType);
-        parcBufferComposer_PutUint16(fullComposer, parcBuffer_Remaining(digest));
-        parcBufferComposer_PutBuffer(fullComposer, digest);
-
-        // Free up memory
-        parcBuffer_Release(&digest);
-        parcBuffer_Release(&prefixBuffer);
-        parcBuffer_Release(&segmentValue);
-    }
-
-    PARCBuffer *finalName = parcBufferComposer_ProduceBuffer(fullComposer);
-    parcBufferComposer_Release(&fullComposer);
-    parcBufferComposer_Release(&composer);
-    ccnxCodecTlvDecoder_Destroy(&decoder);
-
-    // XXX: need to go back and reset the name
-
-    return finalName;
-}
-
-static PARCBuffer *
-_reverseName(PARCHashMap *table, PARCBuffer *buffer)
-{
-    return (PARCBuffer *) parcHashMap_Get(table, buffer);
-}
-
-static CiphertextTag *
-_sealPlaintext(PARCBuffer *plaintext, PARCBuffer *IV, PARCBuffer *keyBuffer)
+// One CSV row: N, mean and standard deviation per stage, cipher and prefix hit
+// rate as before, then p50, p90, p99, p99.9 and max per stage. With hardware
+// counters, each stage's counter totals and per-name averages follow.
+static void
+displayTotalStats(const Histogram *latency, const PerfSample *counts, int N, const char *cipherName, double prefixHitRate)
 {
-    size_t plaintextLength = parcBuffer_Remaining(plaintext);
-    size_t ciphertextLength = plaintextLength + crypto_aead_chacha20poly1305_ABYTES;
-
-    PARCBuffer *ciphertext = parcBuffer_Allocate(ciphertextLength);
-    uint8_t *ciphertextArray = parcBuffer_Overlay(ciphertext, 0);
-    uint8_t *plaintextArray = parcBuffer_Overlay(plaintext, 0);
+    static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+    int stage;
+    size_t p;
 
-    uint8_t *nonce = parcBuffer_Overlay(IV, 0);
-    uint8_t *key = parcBuffer_Overlay(keyBuffer, 0);
-
-    // XXX: maybe add packet metadata as AAD later
-    uint8_t *aad = NULL;
-    size_t aadLength = 0;
-
-    size_t tagLength = crypto_aead_chacha20poly1305_ABYTES;
-    PARCBuffer *tagBuffer = parcBuffer_Allocate(tagLength);
-    uint8_t *tag = parcBuffer_Overlay(tagBuffer, 0);
-
-    // Perform encryption
-    size_t validationLength = 0;
-    int result = crypto_aead_chacha20poly1305_encrypt_detached(ciphertextArray, tag,
-                                                        (unsigned long long *) &validationLength, plaintextArray,
-                                                        plaintextLength, aad, aadLength,
-                                                        NULL, nonce, key);
-    if (result != 0) {
-        parcBuffer_Release(&tagBuffer);
-        parcBuffer_Release(&ciphertext);
-        return NULL;
+    printf("%d,", N);
+    for (stage = 0; stage < TSecStage_Count; stage++) {
+        printf("%f,%f,", histogram_Mean(&latency[stage]), histogram_StandardDeviation(&latency[stage]));
     }
-
-    // Wrap the ciphertext
-    PARCBuffer *ciphertextBuffer = parcBuffer_Allocate(plaintextLength);
-    parcBuffer_PutArray(ciphertextBuffer, plaintextLength, ciphertextArray);
-    parcBuffer_Flip(ciphertextBuffer);
-
-    CiphertextTag *tuple = (CiphertextTag *) malloc(sizeof(CiphertextTag));
-    tuple->ciphertext = parcBuffer_Acquire(ciphertextBuffer);
-    tuple->tag = parcBuffer_Acquire(tagBuffer);
-    tuple->IV = parcBuffer_Acquire(IV);
-
-    parcBuffer_Release(&tagBuffer);
-    parcBuffer_Release(&ciphertextBuffer);
-    parcBuffer_Release(&ciphertext);
-
-    return tuple;
-}
-
-static PARCBuffer *
-_openCiphertext(PARCBuffer *ciphertextBuffer, PARCBuffer *tagBuffer, PARCBuffer *IV, PARCBuffer *keyBuffer)
-{
-    uint8_t *nonce = parcBuffer_Overlay(IV, 0);
-    uint8_t *key = parcBuffer_Overlay(keyBuffer, 0);
-    uint8_t *ciphertext = parcBuffer_Overlay(ciphertextBuffer, 0);
-    uint8_t *tag = parcBuffer_Overlay(tagBuffer, 0);
-
-    uint8_t *aad = NULL;
-    size_t aadLength = 0;
-
-    size_t ciphertextLength = parcBuffer_Remaining(ciphertextBuffer);
-    PARCBuffer *plaintextBuffer = parcBuffer_Allocate(ciphertextLength);
-    uint8_t *plaintext = parcBuffer_Overlay(plaintextBuffer, 0);
-
-    int result = crypto_aead_chacha20poly1305_decrypt_detached(plaintext, NULL, ciphertext,
-                                                        ciphertextLength, tag, aad,
-                                                        aadLength, nonce, key);
-    if (result != -1) {
-        return plaintextBuffer;
-    } else {
-        parcBuffer_Release(&plaintextBuffer);
-        return NULL;
+    printf("%s,", cipherName);
+    printf("%f", prefixHitRate);
+    for (stage = 0; stage < TSecStage_Count; stage++) {
+        for (p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+            printf(",%llu", (unsigned long long) histogram_Percentile(&latency[stage], percentiles[p]));
+        }
+        printf(",%llu", (unsigned long long) latency[stage].max);
     }
-}
-
-static PARCBuffer *
-_deriveKeyFromName(PARCBuffer *nameBuffer)
-{
-    PARCBuffer *keyBuffer = parcBuffer_Allocate(32);
-
-    PARCCryptoHasher *hasher = parcCryptoHasher_Create(PARCCryptoHashType_SHA256);
-    parcCryptoHasher_Init(hasher);
-    parcCryptoHasher_UpdateBuffer(hasher, nameBuffer);
-    PARCCryptoHash *hashDigest = parcCryptoHasher_Finalize(hasher);
-    PARCBuffer *nameDigest = parcCryptoHash_GetDigest(hashDigest);
-
-    uint8_t *nameArray = parcByteArray_Array(parcBuffer_Array(nameDigest));
-    size_t nameArrayLength = parcBuffer_Remaining(nameDigest);
-
-    uint8_t *keyArray = parcByteArray_Array(parcBuffer_Array(keyBuffer));
-    size_t keyLength = parcBuffer_Remaining(keyBuffer);
-
-    uint8_t keyid[crypto_generichash_blake2b_SALTBYTES] = {0};
-    uint8_t appid[crypto_generichash_blake2b_PERSONALBYTES] = {0};
-
-    crypto_generichash_blake2b_salt_personal(keyArray, keyLength,
-                                            NULL, 0,
-                                            nameArray, nameArrayLength,
-                                            keyid, appid);
-    parcCryptoHash_Release(&hashDigest);
-
-    return keyBuffer;
-}
-
-static PARCBuffer *
-_createRandomBuffer(int size)
-{
-    PARCBuffer *buffer = parcBuffer_Allocate(size);
-    parcSecureRandom_NextBytes(rng, buffer);
-    return buffer;
-}
-
-static CiphertextTag *
-_encryptContent(PARCBuffer *name, PARCBuffer *data)
-{
-    // 1. Derive the key from the name
-    PARCBuffer *keyBuffer = _deriveKeyFromName(name);
-
-    // 2. Generate a random IV
-    PARCBuffer *IV = _createRandomBuffer(32);
-
-    // 3. Encrypt the content
-    CiphertextTag *output = _sealPlaintext(data, IV, keyBuffer);
-
-    parcBuffer_Release(&keyBuffer);
-    parcBuffer_Release(&IV);
-
-    return output;
-}
-
-static PARCBuffer *
-_decryptContent(PARCBuffer *name, CiphertextTag *tag)
-{
-    PARCBuffer *keyBuffer = _deriveKeyFromName(name);
-    PARCBuffer *plaintext = _openCiphertext(tag->ciphertext, tag->tag, tag->IV, keyBuffer);
-    return plaintext;
-}
-
-typedef struct {
-    int numComponents;
-    uint64_t obfuscateTime;
-    uint64_t deobfuscateTime;
-    uint64_t encryptTime;
-    uint64_t decryptTime;
-} TSecStatsEntry;
-
-static bool
-_tsecStatsEntry_Destructor(TSecStatsEntry **statsPtr)
-{
-    TSecStatsEntry *stats = *statsPtr;
-    return true;
-}
-
-parcObject_Override(TSecStatsEntry, PARCObject,
-                    .destructor = (PARCObjectDestructor *) _tsecStatsEntry_Destructor);
-
-parcObject_ImplementAcquire(tsecStatsEntry, TSecStatsEntry);
-parcObject_ImplementRelease(tsecStatsEntry, TSecStatsEntry);
-
-TSecStatsEntry *
-tsecStatsEntry_Create(int n)
-{
-    TSecStatsEntry *entry = parcObject_CreateInstance(TSecStatsEntry);
-    entry->numComponents = n;
-    return entry;
-}
-
-static void
-displayStatsEntry(TSecStatsEntry *entry)
-{
-    printf("Obfuscate: %llu\n", entry->obfuscateTime);
-    printf("Deobfuscate: %llu\n", entry->deobfuscateTime);
-    printf("Encrypt: %llu\n", entry->encryptTime);
-    printf("Decrypt: %llu\n", entry->decryptTime);
-}
-
-static void
-displayTotalStats(PARCLinkedList *statList)
-{
-    PARCBasicStats *obfuscateStats = parcBasicStats_Create();
-    PARCBasicStats *deobfuscateStats = parcBasicStats_Create();
-    PARCBasicStats *encryptStats = parcBasicStats_Create();
-    PARCBasicStats *decryptStats = parcBasicStats_Create();
-
-    int N = 0;
-
-    PARCIterator *itr = parcLinkedList_CreateIterator(statList);
-    while (parcIterator_HasNext(itr)) {
-        TSecStatsEntry *entry = (TSecStatsEntry *) parcIterator_Next(itr);
-        N = entry->numComponents;
-
-        parcBasicStats_Update(obfuscateStats, entry->obfuscateTime);
-        parcBasicStats_Update(deobfuscateStats, entry->deobfuscateTime);
-        parcBasicStats_Update(encryptStats, entry->encryptTime);
-        parcBasicStats_Update(decryptStats, entry->decryptTime);
+    if (counts != NULL) {
+        for (stage = 0; stage < TSecStage_Count; stage++) {
+            perfSample_PrintCSV(stdout, &counts[stage], latency[stage].count);
+        }
     }
-
-    printf("%d,", N);
-    printf("%f,%f,", parcBasicStats_Mean(obfuscateStats), parcBasicStats_StandardDeviation(obfuscateStats));
-    printf("%f,%f,", parcBasicStats_Mean(deobfuscateStats), parcBasicStats_StandardDeviation(deobfuscateStats));
-    printf("%f,%f,", parcBasicStats_Mean(encryptStats), parcBasicStats_StandardDeviation(encryptStats));
-    printf("%f,%f\n", parcBasicStats_Mean(decryptStats), parcBasicStats_StandardDeviation(decryptStats));
-
-    parcBasicStats_Release(&obfuscateStats);
-    parcBasicStats_Release(&deobfuscateStats);
-    parcBasicStats_Release(&encryptStats);
-    parcBasicStats_Release(&decryptStats);
+    printf("\n");
 }
 
-typedef enum {
-    HashType_SHA256 = 0x00,
-    HashType_Argon2 = 0x01,
-} HashType;
-
 void
 usage()
 {
-    fprintf(stderr, "usage: tsec_perf <uri_file> <n>\n");
+    fprintf(stderr, "usage: tsec_perf [-a] [-b batch] [-d seconds] [-r names] [-l rate] [-e cipher] [-g pool] [-H file] [-j threads] [-k keys] [-m] [-n secret] [-p cores] [-P] [-s object [-c chunk]] [-o table | -t table] <uri_file> <n> <hash alg> [t m [lanes] | N r p | s t [d [threads]]]\n");
+    fprintf(stderr, "   - -a       = Carve per-name buffers from a per-thread arena instead of the heap\n");
+    fprintf(stderr, "   - batch    = Obfuscate SHA256 names in batches of this size with the multi-buffer kernel\n");
+    fprintf(stderr, "   - seconds  = Throughput mode: cycle through the names for this long and report rates\n");
+    fprintf(stderr, "                per stage instead of latencies\n");
+    fprintf(stderr, "   - names    = Throughput mode: stop after this many names (with -d, whichever is first)\n");
+    fprintf(stderr, "   - rate     = Offered load in names/sec across all threads (default: back to back)\n");
+    fprintf(stderr, "   - cipher   = Content AEAD: chacha20poly1305 (default), chacha20poly1305-ietf,\n");
+    fprintf(stderr, "                xchacha20poly1305-ietf, aes256gcm, or auto (AES-GCM when accelerated)\n");
+    fprintf(stderr, "   - pool     = Serve Argon2 blocks from a reused, pre-faulted pool: prefault, or huge\n");
+    fprintf(stderr, "                to back it with huge pages\n");
+    fprintf(stderr, "   - file     = Also write the full per-stage latency histograms to this file\n");
+    fprintf(stderr, "   - threads  = Number of worker threads sharing the reverse table (default 1)\n");
+    fprintf(stderr, "   - keys     = Capacity of each thread's derived-key cache, 0 to disable (default 65536)\n");
+    fprintf(stderr, "   - -m       = Memoize prefix digests in a per-thread trie so shared prefixes are hashed\n");
+    fprintf(stderr, "                once (SHA256, or a memory-hard hash with -n); the hit rate is the last CSV column\n");
+    fprintf(stderr, "   - secret   = Namespace secret; memory-hard hashes derive their salt from it and the\n");
+    fprintf(stderr, "                prefix instead of drawing a random one, so digests are reproducible\n");
+    fprintf(stderr, "   - cores    = Cores shared by all multi-lane Argon2 hashes (default: all online CPUs)\n");
+    fprintf(stderr, "   - -P       = Count cycles, instructions, LLC, dTLB and branch misses per stage with\n");
+    fprintf(stderr, "                perf_event_open (also TSEC_PERF_COUNTERS=1)\n");
+    fprintf(stderr, "   - object   = Stream objects of this many bytes instead of 1-8 KB single-shot payloads\n");
+    fprintf(stderr, "   - chunk    = Streamed chunk size in bytes (default 65536)\n");
+    fprintf(stderr, "   - -o table = Build the reverse table offline, write it to this file and exit\n");
+    fprintf(stderr, "   - -t table = Map a prebuilt reverse table read-only instead of building one\n");
     fprintf(stderr, "   - uri_file = A file that contains a list of CCNx URIs\n");
     fprintf(stderr, "   - n        = The maximum length prefix\n");
     fprintf(stderr, "   - hash alg = Identifier for the hash algorithm to use\n");
     fprintf(stderr, "       SHA256=0\n");
     fprintf(stderr, "       Argon2=1\n");
+    fprintf(stderr, "       Scrypt=2\n");
+    fprintf(stderr, "       Balloon=3\n");
+    fprintf(stderr, "   - t m lanes = Argon2 passes, memory in bytes and lanes; lanes above 1 run in parallel\n");
+    fprintf(stderr, "   - N r p    = scrypt CPU/memory cost (a power of two), block size and parallelism\n");
+    fprintf(stderr, "   - s t d threads = Balloon space in bytes, rounds, neighbors per block and the library's\n");
+    fprintf(stderr, "                n_threads; the mix is always single-buffer, and threads changes the digest\n");
+    fprintf(stderr, "   SHA256 prefixes are hashed incrementally; memory-hard hashes re-hash each full prefix\n");
+    fprintf(stderr, "   Output: N, mean and stddev per stage, cipher, prefix hit rate, then p50, p90, p99,\n");
+    fprintf(stderr, "   p99.9 and max per stage (obfuscate, deobfuscate, encrypt, decrypt), in nanoseconds;\n");
+    fprintf(stderr, "   with -P, then per stage the cycles, instructions, llc_misses, dtlb_misses and\n");
+    fprintf(stderr, "   branch_misses totals followed by the same counts per name\n");
 }
 
 int
 main(int argc, char **argv)
 {
-    if (argc < 4) {
+    buildInfo_Report();
+
+    BenchOptions options;
+    benchOptions_Init(&options);
+    if (!benchOptions_Parse(&options, argc, argv, TSEC_OPTIONS) || options.argc < 3) {
         usage();
         exit(-1);
     }
 
+    if (sodium_init() < 0) {
+        fprintf(stderr, "Could not initialize libsodium\n");
+        exit(-1);
+    }
     argon2_init();
+    balloon_init();
+    cycleTimer_Init();
+    fprintf(stderr, "timer: %s at %.0f Hz, %.1f ns overhead subtracted\n", cycleTimer_Source(), cycleTimer_Frequency(),
+            cycleTimer_OverheadNanos());
 
-    char *fname = argv[1];
-    int N = atoi(argv[2]);
-
-    FILE *file = fopen(fname, "r");
-    if (file == NULL) {
-        perror("Could not open file");
+    Pipeline pipeline;
+    if (!pipeline_Setup(&pipeline, &options)) {
         usage();
         exit(-1);
     }
 
-    int hashAlgorithm = atoi(argv[3]);
-    PARCCryptoHasher *hasher = NULL;
-    switch (hashAlgorithm) {
-        case HashType_SHA256:
-            hasher = parcCryptoHasher_Create(PARCCryptoHashType_SHA256);
-            break;
-        case HashType_Argon2: {
-            if (argc >= 6) { // override the default parameters if present
-                argon2TCost = atoi(argv[4]);
-                argon2MCost = atoi(argv[5]);
-            }
-            hasher = parcCryptoHasher_CustomHasher(0, functor_argon2);
-            break;
-        }
-        default:
-            usage();
-            exit(-1);
-            break;
+    if (options.buildTablePath != NULL) {
+        return pipeline_BuildTable(&pipeline);
     }
 
-    // Create the list to hold all of the names
-    PARCLinkedList *nameList = parcLinkedList_Create();
-
-    int num = 0;
-    int index = 0;
-    do {
-        PARCBufferComposer *composer = readLine(file);
-        PARCBuffer *bufferString = parcBufferComposer_ProduceBuffer(composer);
-        if (peekFile(file) == EOF) {
-            break;
-        }
-        parcBufferComposer_Release(&composer);
-
-        if (!parcBuffer_HasRemaining(bufferString)) {
-            parcBuffer_Release(&bufferString);
-            continue;
-        }
-
-        // Create the original name and store it for later
-        //fprintf(stderr, "Parsing: %s\n", parcBuffer_ToString(bufferString));
-        CCNxName *name = ccnxName_CreateFromBuffer(bufferString);
-        parcBuffer_Release(&bufferString);
-        if (name == NULL) {
-            continue;
-        }
+    if (!pipeline_Run(&pipeline)) {
+        usage();
+        exit(-1);
+    }
 
-        // Trim the name if necessary
-        if (ccnxName_GetSegmentCount(name) > N) {
-            size_t delta = ccnxName_GetSegmentCount(name) - N;
-            name = ccnxName_Trim(name, delta);
+    if (pipeline.sustained) {
+        throughput_Report(&pipeline.throughput, options.numThreads, pipeline.wallTime, options.offeredLoad);
+        if (perfCounters_Enabled()) {
+            int stage;
+            for (stage = 0; stage < TSecStage_Count; stage++) {
+                printf("counters=%s", tsecStageNames[stage]);
+                perfSample_PrintFields(stdout, &pipeline.counts[stage], pipeline.throughput.names);
+                printf("\n");
+            }
         }
-
-        // Debug display
-        //char *nameString = ccnxName_ToString(name);
-        //fprintf(stderr, "Read %d: %s\n", index, nameString);
-
-        CCNxCodecTlvEncoder *encoder = ccnxCodecTlvEncoder_Create();
-        ccnxCodecSchemaV1NameCodec_Encode(encoder, CCNxCodecSchemaV1Types_CCNxMessage_Name, name);
-        ccnxCodecTlvEncoder_Finalize(encoder);
-        PARCBuffer *encodedBuffer = ccnxCodecTlvEncoder_CreateBuffer(encoder);
-        ccnxCodecTlvEncoder_Destroy(&encoder);
-
-        parcLinkedList_Append(nameList, encodedBuffer);
-
-        ccnxName_Release(&name);
-        index++;
-    } while (true);
-
-    PARCLinkedList *stats = parcLinkedList_Create();
-    PARCHashMap *table = parcHashMap_Create();
-    rng = parcSecureRandom_Create();
-    PARCIterator *iterator = parcLinkedList_CreateIterator(nameList);
-    while (parcIterator_HasNext(iterator)) {
-
-        PARCBuffer *nameBuffer = parcIterator_Next(iterator);
-
-        PARCStopwatch *timer = parcStopwatch_Create();
-        parcStopwatch_Start(timer);
-
-        // 1. Obfuscation
-        uint64_t startObfuscationTime = parcStopwatch_ElapsedTimeNanos(timer);
-        PARCBuffer *obfuscatedName = _obfuscateName(hasher, nameBuffer);
-        uint64_t endObfuscationTime = parcStopwatch_ElapsedTimeNanos(timer);
-
-        // Save the mapping in the table (this is an offline step)
-        parcHashMap_Put(table, obfuscatedName, nameBuffer);
-
-        // 2. De-obfuscation
-        uint64_t startDeobfuscationTime = parcStopwatch_ElapsedTimeNanos(timer);
-        PARCBuffer *originalNameBuffer = _reverseName(table, obfuscatedName);
-        uint64_t endDeobfuscationTime = parcStopwatch_ElapsedTimeNanos(timer);
-
-        assertNotNull(originalNameBuffer, "Expected the original name to be retrieved");
-
-        // 3. Encryption
-        size_t dataSize = randomDataSize();
-        PARCBuffer *dataBuffer = _createRandomBuffer(dataSize);
-        uint64_t startEncryptionTime = parcStopwatch_ElapsedTimeNanos(timer);
-        CiphertextTag *ciphertext = _encryptContent(nameBuffer, dataBuffer);
-        uint64_t endEncryptionTime = parcStopwatch_ElapsedTimeNanos(timer);
-
-        // 4. Decryption
-        uint64_t startDecryptionTime = parcStopwatch_ElapsedTimeNanos(timer);
-        PARCBuffer *reverseName = _reverseName(table, obfuscatedName);
-        PARCBuffer *plaintext = _decryptContent(nameBuffer, ciphertext);
-        uint64_t endDecryptionTime = parcStopwatch_ElapsedTimeNanos(timer);
-
-        assertTrue(parcBuffer_Equals(originalNameBuffer, reverseName), "Expected name retrieval to succeed");
-        assertTrue(parcBuffer_Equals(plaintext, dataBuffer), "Expected decryption to succeed");
-
-        parcBuffer_Release(&dataBuffer);
-        parcBuffer_Release(&obfuscatedName);
-        parcBuffer_Release(&originalNameBuffer);
-        parcBuffer_Release(&reverseName);
-        parcBuffer_Release(&plaintext);
-
-        TSecStatsEntry *entry = tsecStatsEntry_Create(N);
-        entry->obfuscateTime = endObfuscationTime - startObfuscationTime;
-        entry->deobfuscateTime = endDeobfuscationTime - startDeobfuscationTime;
-        entry->encryptTime = endEncryptionTime - startEncryptionTime;
-        entry->decryptTime = endDecryptionTime - startDecryptionTime;
-
-        // Append the stats entry
-        parcLinkedList_Append(stats, entry);
-        //displayStatsEntry(entry);
-
-        parcStopwatch_Release(&timer);
+    } else {
+        displayTotalStats(pipeline.latency, perfCounters_Enabled() ? pipeline.counts : NULL, pipeline.N,
+                          pipeline.cipherName, pipeline_PrefixHitRate(&pipeline));
     }
-
-    displayTotalStats(stats);
-
-    parcHashMap_Release(&table);
-    parcLinkedList_Release(&stats);
+    pipeline_Release(&pipeline);
 
     return 0;
 }
@@ -0,0 +1,116 @@
+#include <parc/algol/parc_Memory.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Reads a file of CCNx URIs, one per line, without copying it. The file is
+// mapped read-only, line ends are found with memchr, and characters are checked
+// against a 256-entry table. Each URI is the run of valid characters at the
+// start of its line; blank lines are skipped and a final line without a
+// trailing newline is still returned.
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t offset;
+} URILoader;
+
+static bool uriLoaderValid[256];
+static bool uriLoaderValidInitialized = false;
+
+static void
+_uriLoader_InitTable(void)
+{
+    const char *punctuation = ":/._()[]-%+=;$'";
+    int c;
+    for (c = 0; c < 256; c++) {
+        uriLoaderValid[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+    for (; *punctuation != '\0'; punctuation++) {
+        uriLoaderValid[(uint8_t) *punctuation] = true;
+    }
+    uriLoaderValidInitialized = true;
+}
+
+/**
+ * Map path for reading. Returns NULL (with errno set) if it cannot be opened.
+ */
+URILoader *
+uriLoader_Open(const char *path)
+{
+    if (!uriLoaderValidInitialized) {
+        _uriLoader_InitTable();
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    URILoader *loader = parcMemory_AllocateAndClear(sizeof(URILoader));
+    loader->length = (size_t) status.st_size;
+    loader->offset = 0;
+    loader->data = NULL;
+    if (loader->length > 0) {
+        void *mapping = mmap(NULL, loader->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            parcMemory_Deallocate(&loader);
+            return NULL;
+        }
+        madvise(mapping, loader->length, MADV_SEQUENTIAL);
+        loader->data = mapping;
+    }
+    close(fd);
+
+    return loader;
+}
+
+/**
+ * Advance to the next URI. On success, *uri points into the mapping (valid
+ * until uriLoader_Close) and *length is its length in bytes.
+ */
+bool
+uriLoader_Next(URILoader *loader, const uint8_t **uri, size_t *length)
+{
+    while (loader->offset < loader->length) {
+        const uint8_t *line = loader->data + loader->offset;
+        size_t remaining = loader->length - loader->offset;
+        const uint8_t *newline = memchr(line, '\n', remaining);
+        size_t lineLength = newline != NULL ? (size_t) (newline - line) : remaining;
+        loader->offset += lineLength + (newline != NULL ? 1 : 0);
+
+        size_t validLength = 0;
+        while (validLength < lineLength && uriLoaderValid[line[validLength]]) {
+            validLength++;
+        }
+
+        if (validLength > 0) {
+            *uri = line;
+            *length = validLength;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+uriLoader_Close(URILoader **loaderPtr)
+{
+    URILoader *loader = *loaderPtr;
+    if (loader->data != NULL) {
+        munmap(loader->data, loader->length);
+    }
+    parcMemory_Deallocate(loaderPtr);
+}
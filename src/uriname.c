@@ -0,0 +1,148 @@
+#include <ccnx/common/ccnx_NameLabel.h>
+#include <ccnx/common/codec/schema_v1/ccnxCodecSchemaV1_Types.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Single-pass CCNx URI handling for plain names, without building a CCNxName.
+//
+// uriName_Parse splits a "ccnx:/" or "lci:/" URI into percent-decoded segment
+// values laid back to back, so values[0, ends[i]) is exactly the i-th prefix
+// that gets hashed. URIs this parser does not cover (labeled segments such as
+// "Chunk=1", empty segments, malformed escapes) are rejected so that callers
+// can fall back to ccnxName_CreateFromBuffer, which keeps the encodings equal.
+// So are URIs whose encoding would not fit the 16-bit TLV length fields.
+
+#define URI_NAME_MAX_SEGMENTS 1024
+#define URI_NAME_MAX_LENGTH 0xFFFF
+#define URI_NAME_SEGMENT_TYPE CCNxNameLabelType_NAME
+
+static int
+_uriName_HexValue(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Parse uri into at most maxSegments segments (later segments are validated
+ * and dropped, as ccnxName_Trim would). values must hold URI_NAME_MAX_LENGTH
+ * bytes and ends URI_NAME_MAX_SEGMENTS entries. Returns the number of segments
+ * kept, or -1 if the URI needs the full name parser.
+ */
+int
+uriName_Parse(const uint8_t *uri, size_t length, int maxSegments, uint8_t *values, size_t *ends)
+{
+    size_t offset;
+    if (length >= 6 && memcmp(uri, "ccnx:/", 6) == 0) {
+        offset = 6;
+    } else if (length >= 5 && memcmp(uri, "lci:/", 5) == 0) {
+        offset = 5;
+    } else {
+        return -1;
+    }
+
+    int count = 0;
+    size_t valueLength = 0;
+    size_t segmentStart = valueLength;
+    while (offset <= length) {
+        if (offset == length || uri[offset] == '/') {
+            if (valueLength == segmentStart || count == URI_NAME_MAX_SEGMENTS) {
+                return -1;
+            }
+            ends[count++] = valueLength;
+            segmentStart = valueLength;
+            offset++;
+            continue;
+        }
+
+        // The segment headers and values must fit in one name TLV, which also
+        // bounds every segment and the values array
+        if (4 * (size_t) (count + 1) + valueLength >= URI_NAME_MAX_LENGTH) {
+            return -1;
+        }
+
+        uint8_t c = uri[offset];
+        if (c == '=') {
+            return -1;
+        } else if (c == '%') {
+            if (offset + 2 >= length) {
+                return -1;
+            }
+            int high = _uriName_HexValue(uri[offset + 1]);
+            int low = _uriName_HexValue(uri[offset + 2]);
+            if (high < 0 || low < 0) {
+                return -1;
+            }
+            values[valueLength++] = (uint8_t) ((high << 4) | low);
+            offset += 3;
+        } else {
+            values[valueLength++] = c;
+            offset++;
+        }
+    }
+
+    return count < maxSegments ? count : maxSegments;
+}
+
+/**
+ * Write a 4-byte TLV header (type, length; network byte order) at output.
+ * length must not exceed URI_NAME_MAX_LENGTH.
+ */
+void
+uriName_PutHeader(uint8_t *output, uint16_t type, size_t length)
+{
+    assertTrue(length <= URI_NAME_MAX_LENGTH, "TLV length %zu does not fit in 16 bits", length);
+    output[0] = (uint8_t) (type >> 8);
+    output[1] = (uint8_t) type;
+    output[2] = (uint8_t) (length >> 8);
+    output[3] = (uint8_t) length;
+}
+
+/**
+ * Read the 4-byte TLV header at input.
+ */
+void
+uriName_GetHeader(const uint8_t *input, uint16_t *type, size_t *length)
+{
+    *type = (uint16_t) ((input[0] << 8) | input[1]);
+    *length = (size_t) ((input[2] << 8) | input[3]);
+}
+
+/**
+ * Length of the TLV encoding of the first count parsed segments.
+ */
+size_t
+uriName_EncodedLength(int count, const size_t *ends)
+{
+    return 4 + 4 * (size_t) count + (count > 0 ? ends[count - 1] : 0);
+}
+
+/**
+ * Write the schema v1 TLV name for the first count parsed segments into output,
+ * which must hold uriName_EncodedLength bytes. The bytes match what
+ * ccnxCodecSchemaV1NameCodec_Encode produces for the same name.
+ */
+void
+uriName_Encode(int count, const uint8_t *values, const size_t *ends, uint8_t *output)
+{
+    size_t total = uriName_EncodedLength(count, ends);
+    uriName_PutHeader(output, CCNxCodecSchemaV1Types_CCNxMessage_Name, total - 4);
+
+    size_t position = 4;
+    size_t start = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        size_t segmentLength = ends[i] - start;
+        uriName_PutHeader(output + position, URI_NAME_SEGMENT_TYPE, segmentLength);
+        memcpy(output + position + 4, values + start, segmentLength);
+        position += 4 + segmentLength;
+        start = ends[i];
+    }
+}